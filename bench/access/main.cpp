@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ *
+ * Measures the cost of a register access within the instrument process,
+ * without any transport. The same register file is accessed through the
+ * per-width virtual accessors that instruments used to override, through the
+ * default access() that dispatches to them and through the access() fast
+ * path of BaseInstrument. The last case goes through the address decoder of
+ * InstrumentContainer as well.
+ **/
+
+#include "BaseInstrument.h"
+#include "InstrumentContainer.h"
+
+#include <stdio.h>
+#include <time.h>
+
+#include <functional>
+
+#define BENCH_ITERATIONS 10000000
+
+/** Instrument that overrides the per-width accessors */
+class VirtualInstrument : public IInstrument {
+    public:
+	VirtualInstrument()
+	{
+		memset(&regs, 0, sizeof(regs));
+	}
+	int write32(uint64_t addr, uint64_t data) override
+	{
+		if (addr + sizeof(uint32_t) > sizeof(regs)) {
+			return -EIO;
+		}
+		*(uint32_t *)((uint8_t *)&regs + addr) = data;
+		return 0;
+	}
+	int read32(uint64_t addr, uint64_t *data) override
+	{
+		if (addr + sizeof(uint32_t) > sizeof(regs)) {
+			*data = ~0;
+			return -EIO;
+		}
+		*data = *(uint32_t *)((uint8_t *)&regs + addr);
+		return 0;
+	}
+	void tick() override
+	{
+	}
+	void onIRQ(std::function<void()> cb) override
+	{
+	}
+
+    private:
+	struct keypad_instrument regs;
+};
+
+/** Instrument that only uses the register file of BaseInstrument */
+class FastInstrument : public BaseInstrument<struct keypad_instrument, FastInstrument> {
+};
+
+/** Container exposing its access() entry point */
+class BenchContainer : public InstrumentContainer {
+    public:
+	using InstrumentContainer::access;
+};
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void report(const char *name, std::function<int(uint64_t addr, uint64_t *value)> fn)
+{
+	uint64_t value = 0;
+	uint64_t sum = 0;
+	uint64_t start = now_ns();
+
+	for (int c = 0; c < BENCH_ITERATIONS; c++) {
+		uint64_t addr = (c & 1) * sizeof(uint32_t);
+
+		value = c;
+		fn(addr, &value);
+		sum += value;
+	}
+
+	uint64_t elapsed = now_ns() - start;
+
+	printf("%-10s %6.2f ns per access (%lx)\n", name, (double)elapsed / BENCH_ITERATIONS,
+	       (unsigned long)sum);
+}
+
+int main(int argc, char **argv)
+{
+	VirtualInstrument legacy;
+	FastInstrument fast;
+	BenchContainer container;
+	IPeripheral *a = &legacy;
+	IPeripheral *b = &fast;
+
+	container.addInstrument(&fast, 0x1000, sizeof(struct keypad_instrument));
+
+	printf("register access within the instrument (%d iterations, alternating read/write)\n",
+	       BENCH_ITERATIONS);
+	report("read32", [a](uint64_t addr, uint64_t *value) {
+		return (addr ? a->write32(addr, *value) : a->read32(addr, value));
+	});
+	report("dispatch", [a](uint64_t addr, uint64_t *value) {
+		return a->access(addr, sizeof(uint32_t), addr != 0, value);
+	});
+	report("access", [b](uint64_t addr, uint64_t *value) {
+		return b->access(addr, sizeof(uint32_t), addr != 0, value);
+	});
+	report("container", [&container](uint64_t addr, uint64_t *value) {
+		return container.access(0x1000 + addr, sizeof(uint32_t), addr != 0, value);
+	});
+	return 0;
+}
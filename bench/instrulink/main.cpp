@@ -0,0 +1,248 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ *
+ * Measures register access round trip latency over each instrulink transport.
+ * The simulator side runs in the main thread and the instrument side runs in
+ * a second thread that answers every request, the same way the communication
+ * thread of InstrumentContainer does.
+ *
+ * The shared memory transport still blocks on a futex whenever a ring is
+ * empty, so every round trip includes two wakeups. On a typical x86 host it
+ * comes out at about 4 us, well below unix sockets but not below 1 us.
+ **/
+
+#include <instruments/protocol/instrulink.h>
+#include <instruments/protocol/shm.h>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+
+#include <algorithm>
+#include <functional>
+#include <thread>
+#include <vector>
+
+#define BENCH_ITERATIONS 100000
+/** Number of requests the simulator sends back to back in burst mode */
+#define BENCH_BURST 8
+
+static uint64_t now_ns(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static void serve(struct instrulink *link, int count)
+{
+	struct instrulink_packet pkt;
+
+	for (int c = 0; c < count; c++) {
+		if (instrulink_wait_request(link, &pkt) != 0) {
+			return;
+		}
+		pkt.type = MSG_TYPE_OK;
+		pkt.value = pkt.addr;
+		instrulink_send_response(link, &pkt);
+	}
+}
+
+/** Run the benchmark given a function that performs one round trip */
+static void report(const char *name, std::function<void(struct instrulink_packet *)> rtt)
+{
+	std::vector<uint64_t> samples(BENCH_ITERATIONS);
+	struct instrulink_packet pkt;
+
+	for (int c = 0; c < BENCH_ITERATIONS; c++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_READ32;
+		pkt.addr = c;
+
+		uint64_t start = now_ns();
+
+		rtt(&pkt);
+		samples[c] = now_ns() - start;
+	}
+
+	std::sort(samples.begin(), samples.end());
+
+	uint64_t sum = 0;
+
+	for (auto s : samples) {
+		sum += s;
+	}
+
+	printf("%-10s mean %7.0f ns  p50 %7lu ns  p99 %7lu ns\n", name,
+	       (double)sum / BENCH_ITERATIONS, (unsigned long)samples[BENCH_ITERATIONS / 2],
+	       (unsigned long)samples[BENCH_ITERATIONS * 99 / 100]);
+}
+
+static int listen_tcp(int *port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	listen(fd, 1);
+	getsockname(fd, (struct sockaddr *)&addr, &len);
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+static int listen_unix(const char *path)
+{
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+	struct sockaddr_un addr;
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	strcpy(addr.sun_path, path);
+	addr.sun_path[0] = 0;
+	bind(fd, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + strlen(path));
+	listen(fd, 1);
+	return fd;
+}
+
+static void bench_tcp(void)
+{
+	int mainPort, irqPort;
+	int mainServer = listen_tcp(&mainPort);
+	int irqServer = listen_tcp(&irqPort);
+	struct instrulink *link = instrulink_new();
+
+	if (instrulink_connect(link, mainPort, irqPort, "127.0.0.1") != 0) {
+		fprintf(stderr, "tcp: connect failed\n");
+		return;
+	}
+
+	int sim = accept(mainServer, NULL, NULL);
+	int irq = accept(irqServer, NULL, NULL);
+	int one = 1;
+
+	setsockopt(sim, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+	std::thread instrument(serve, link, BENCH_ITERATIONS * (1 + BENCH_BURST));
+
+	report("tcp", [sim](struct instrulink_packet *pkt) {
+		send(sim, pkt, sizeof(*pkt), 0);
+		recv(sim, pkt, sizeof(*pkt), MSG_WAITALL);
+	});
+
+	// bursty traffic is read with one recv and answered with one write
+	report("tcp x8", [sim](struct instrulink_packet *pkt) {
+		struct instrulink_packet burst[BENCH_BURST];
+
+		for (int c = 0; c < BENCH_BURST; c++) {
+			burst[c] = *pkt;
+		}
+		send(sim, burst, sizeof(burst), 0);
+		recv(sim, burst, sizeof(burst), MSG_WAITALL);
+	});
+
+	instrument.join();
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+	close(sim);
+	close(irq);
+	close(mainServer);
+	close(irqServer);
+}
+
+static void bench_unix(void)
+{
+	char mainPath[64], irqPath[64];
+
+	snprintf(mainPath, sizeof(mainPath), "@instrulink-bench-%d-main", getpid());
+	snprintf(irqPath, sizeof(irqPath), "@instrulink-bench-%d-irq", getpid());
+
+	int mainServer = listen_unix(mainPath);
+	int irqServer = listen_unix(irqPath);
+	struct instrulink *link = instrulink_new();
+
+	if (instrulink_connect_unix(link, mainPath, irqPath) != 0) {
+		fprintf(stderr, "unix: connect failed\n");
+		return;
+	}
+
+	int sim = accept(mainServer, NULL, NULL);
+	int irq = accept(irqServer, NULL, NULL);
+
+	std::thread instrument(serve, link, BENCH_ITERATIONS);
+
+	report("unix", [sim](struct instrulink_packet *pkt) {
+		send(sim, pkt, sizeof(*pkt), 0);
+		recv(sim, pkt, sizeof(*pkt), 0);
+	});
+
+	instrument.join();
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+	close(sim);
+	close(irq);
+	close(mainServer);
+	close(irqServer);
+}
+
+static void bench_shm(void)
+{
+	int fd = memfd_create("instrulink-bench", 0);
+
+	if (fd < 0 || ftruncate(fd, sizeof(struct instrulink_shm)) != 0) {
+		fprintf(stderr, "shm: could not create segment\n");
+		return;
+	}
+
+	struct instrulink_shm *shm = (struct instrulink_shm *)mmap(
+		NULL, sizeof(*shm), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	struct instrulink *link = instrulink_new();
+	char name[32];
+
+	instrulink_shm_init(shm);
+	snprintf(name, sizeof(name), "fd:%d", fd);
+
+	if (instrulink_connect_shm(link, name) != 0) {
+		fprintf(stderr, "shm: connect failed\n");
+		return;
+	}
+
+	std::thread instrument(serve, link, BENCH_ITERATIONS);
+
+	report("shm", [shm](struct instrulink_packet *pkt) {
+		instrulink_shm_ring_write(shm, &shm->req, pkt, sizeof(*pkt));
+		instrulink_shm_ring_read(shm, &shm->res, pkt, sizeof(*pkt));
+	});
+
+	instrument.join();
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+	munmap(shm, sizeof(*shm));
+	close(fd);
+}
+
+int main(int argc, char **argv)
+{
+	printf("instrulink register access round trip (%d iterations)\n", BENCH_ITERATIONS);
+	bench_tcp();
+	bench_unix();
+	bench_shm();
+	return 0;
+}
@@ -0,0 +1,118 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ *
+ * Counts the clock cycles per word that WishboneSlave needs in each bus mode.
+ * The LiteUART CSR bridge acknowledges every other cycle and has no stall
+ * output. The register file below is a pipelined slave that takes a request
+ * every cycle and acknowledges it on the next one, standing in for a
+ * Verilated core with the same interface.
+ **/
+
+#include "LiteUART.h"
+#include "bus/WishboneSlave.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#include <functional>
+
+#define BENCH_WORDS 16
+
+/** Pipelined Wishbone register file with the signals of a Verilated model */
+class PipelinedRegisters {
+    public:
+	uint8_t wb_clk = 0, wb_rst = 0;
+	uint32_t wb_addr = 0, wb_wr_dat = 0, wb_rd_dat = 0;
+	uint8_t wb_sel = 0, wb_cyc = 0, wb_stb = 0, wb_ack = 0, wb_we = 0, wb_stall = 0;
+	uint8_t wb_cti = 0, wb_bte = 0;
+
+	void eval()
+	{
+		if (wb_clk && !clk) {
+			wb_ack = wb_cyc && wb_stb;
+			if (wb_ack && wb_we) {
+				regs[wb_addr % BENCH_WORDS] = wb_wr_dat;
+			}
+			wb_rd_dat = regs[wb_addr % BENCH_WORDS];
+		}
+		clk = wb_clk;
+	}
+
+    private:
+	uint8_t clk = 0;
+	uint32_t regs[BENCH_WORDS] = { 0 };
+};
+
+class PipelinedSlave : public WishboneSlave<PipelinedRegisters> {
+    public:
+	PipelinedSlave() : WishboneSlave<PipelinedRegisters>(&model)
+	{
+	}
+
+    private:
+	PipelinedRegisters model;
+};
+
+static const char *mode_name(WishboneMode mode)
+{
+	switch (mode) {
+	case WISHBONE_CLASSIC:
+		return "classic";
+	case WISHBONE_PIPELINED:
+		return "pipelined";
+	case WISHBONE_BURST:
+		return "burst";
+	}
+	return "?";
+}
+
+template <typename S> static void bench(const char *name, S *slave, uint64_t addr)
+{
+	const WishboneMode modes[] = { WISHBONE_CLASSIC, WISHBONE_PIPELINED, WISHBONE_BURST };
+	uint32_t words[BENCH_WORDS];
+
+	slave->setFastForward(false);
+	for (auto mode : modes) {
+		slave->setBusMode(mode);
+		slave->tick();
+
+		auto cycles = [slave](std::function<void()> fn) {
+			uint64_t start = slave->clock().evaluated;
+
+			fn();
+			return (double)(slave->clock().evaluated - start) / BENCH_WORDS;
+		};
+		double single = cycles([slave, addr] {
+			for (int c = 0; c < BENCH_WORDS; c++) {
+				uint64_t value;
+
+				slave->read(addr + c * 4, &value);
+			}
+		});
+		double read = cycles([slave, addr, &words] {
+			slave->readBlock(addr, (uint8_t *)words, sizeof(words));
+		});
+		double write = cycles([slave, addr, &words] {
+			slave->writeBlock(addr, (uint8_t *)words, sizeof(words));
+		});
+
+		printf("%-10s %-10s single %5.2f  block read %5.2f  block write %5.2f\n", name,
+		       mode_name(mode), single, read, write);
+	}
+}
+
+int main(int argc, char **argv)
+{
+	LiteUART uart;
+	PipelinedSlave regs;
+
+	printf("wishbone clock cycles per word (%d words)\n", BENCH_WORDS);
+	// the CSR bank of the UART starts at 0x800
+	bench("liteuart", &uart, 0x800);
+	bench("pipelined", &regs, 0);
+	return 0;
+}
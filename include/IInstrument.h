@@ -13,13 +13,91 @@
 
 #include <IPeripheral.h>
 
+#include <stdio.h>
+
 #include <functional>
+#include <vector>
+
+class TimingWheel;
 
 class IInstrument : public IPeripheral {
     public:
+	/** Registers cb to be called every period_ns nanoseconds */
+	typedef std::function<int(uint64_t period_ns, std::function<void()> cb)> TimerRegistry;
+
+	/** Range of register offsets */
+	struct Region {
+		uint64_t base;
+		uint64_t size;
+	};
+
 	virtual ~IInstrument()
 	{
 	}
-	/** This will be called by InstrumentContainer to render the instrument */
-	virtual void render() = 0;
+	/**
+	 * \brief Read a register from the last published state
+	 * \details Called by InstrumentContainer without the lock held to
+	 * answer reads that have no side effects. The state is published after
+	 * every locked section so the value is never older than the last
+	 * request.
+	 * \retval -EAGAIN register has to be read with access() under the lock
+	 **/
+	virtual int peek(uint64_t addr, unsigned width, uint64_t *data)
+	{
+		return -EAGAIN;
+	}
+	/**
+	 * \brief Regions that only change when written over the bus
+	 * \details The simulator may cache reads of these regions as long as
+	 * it updates the cache on its own writes.
+	 **/
+	virtual std::vector<Region> cacheable()
+	{
+		return std::vector<Region>();
+	}
+	/**
+	 * Called by InstrumentContainer when the instrument is added. Timer
+	 * callbacks run on the event loop with the container lock held so the
+	 * instrument is simulated at its own cadence whether or not it is
+	 * rendered.
+	 **/
+	virtual void setupTimers(TimerRegistry addTimer)
+	{
+	}
+	/**
+	 * Called by InstrumentContainer when the instrument is added with the
+	 * scheduler for events in simulated time. Events fire while the
+	 * simulator advances time with the instrument advanced up to the time
+	 * of the event. The scheduler may only be used with the container lock
+	 * held (from register accesses, advance(), timers and event callbacks).
+	 **/
+	virtual void setScheduler(TimingWheel *wheel)
+	{
+	}
+	/**
+	 * This will be called by InstrumentContainer to render the instrument.
+	 * Rendering happens without the container lock held so render() must
+	 * only use the view updated by refresh() and queue its edits. Widgets
+	 * are drawn into the window of the container (not a window of their
+	 * own) and all state of the view belongs in the instrument object. Only
+	 * the views in the GUI library render anything.
+	 **/
+	virtual void render()
+	{
+	}
+	/**
+	 * Apply queued edits and publish the current state for rendering.
+	 * Called by InstrumentContainer with the lock held.
+	 **/
+	virtual void commit()
+	{
+	}
+	/** Update the view used by render(). Called from the GUI thread before rendering. */
+	virtual void refresh()
+	{
+	}
+	/** Write the last published state as one line of telemetry. Safe to call from any thread. */
+	virtual void telemetry(FILE *out)
+	{
+	}
 };
@@ -10,6 +10,11 @@
  **/
 #pragma once
 
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
 #include <functional>
 
 /**
@@ -31,12 +36,124 @@ class IPeripheral {
 
 	virtual void tick() = 0;
 
-	virtual int write32(uint64_t addr, uint64_t data) = 0;
-	virtual int write16(uint64_t addr, uint64_t data) = 0;
-	virtual int write8(uint64_t addr, uint64_t data) = 0;
-	virtual int read32(uint64_t addr, uint64_t *data) = 0;
-	virtual int read16(uint64_t addr, uint64_t *data) = 0;
-	virtual int read8(uint64_t addr, uint64_t *data) = 0;
+	/**
+	 * \brief Advance simulated time of the peripheral
+	 * \details Called for every quantum of simulated time granted by the
+	 * simulator. Peripherals that do not model time can ignore it.
+	 * \param ns length of the quantum in nanoseconds
+	 **/
+	virtual void advance(uint64_t ns)
+	{
+	}
+
+	/**
+	 * \brief Called once all time of a quantum has been granted
+	 * \details Peripherals that only account for time in advance() bring
+	 * their model up to date here and report their interrupt output so
+	 * that interrupts are seen within the quantum they are raised in.
+	 * Instruments may be settled in parallel like they are advanced.
+	 **/
+	virtual void endQuantum()
+	{
+	}
+
+	/**
+	 * \brief Read or write a register
+	 * \details This is the entry point used by the instrument container. The
+	 * default implementation dispatches to the accessor of the given width
+	 * so peripherals can implement either this or the accessors below.
+	 * \param addr offset of the register
+	 * \param width access size in bytes (1, 2 or 4)
+	 * \param write true to write *data, false to read into *data
+	 * \param data value to write or buffer receiving the value read
+	 * \retval -ENOTSUP width is not supported by the peripheral
+	 **/
+	virtual int access(uint64_t addr, unsigned width, bool write, uint64_t *data)
+	{
+		switch (width) {
+		case sizeof(uint8_t):
+			return write ? write8(addr, *data) : read8(addr, data);
+		case sizeof(uint16_t):
+			return write ? write16(addr, *data) : read16(addr, data);
+		case sizeof(uint32_t):
+			return write ? write32(addr, *data) : read32(addr, data);
+		}
+		return -ENOTSUP;
+	}
+
+	virtual int write32(uint64_t addr, uint64_t data)
+	{
+		return -ENOTSUP;
+	}
+	virtual int write16(uint64_t addr, uint64_t data)
+	{
+		return -ENOTSUP;
+	}
+	virtual int write8(uint64_t addr, uint64_t data)
+	{
+		return -ENOTSUP;
+	}
+	virtual int read32(uint64_t addr, uint64_t *data)
+	{
+		return -ENOTSUP;
+	}
+	virtual int read16(uint64_t addr, uint64_t *data)
+	{
+		return -ENOTSUP;
+	}
+	virtual int read8(uint64_t addr, uint64_t *data)
+	{
+		return -ENOTSUP;
+	}
+
+	/**
+	 * \brief Write a block of consecutive registers
+	 * \details Default implementation issues one write32 per word.
+	 * \retval -EINVAL address or length is not word aligned
+	 **/
+	virtual int writeBlock(uint64_t addr, const uint8_t *data, size_t len)
+	{
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		for (size_t c = 0; c < len; c += sizeof(uint32_t)) {
+			uint32_t word;
+
+			memcpy(&word, &data[c], sizeof(word));
+
+			int r = write32(addr + c, word);
+
+			if (r != 0) {
+				return r;
+			}
+		}
+		return 0;
+	}
+
+	/**
+	 * \brief Read a block of consecutive registers
+	 * \details Default implementation issues one read32 per word.
+	 * \retval -EINVAL address or length is not word aligned
+	 **/
+	virtual int readBlock(uint64_t addr, uint8_t *data, size_t len)
+	{
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		for (size_t c = 0; c < len; c += sizeof(uint32_t)) {
+			uint64_t value;
+			int r = read32(addr + c, &value);
+
+			if (r != 0) {
+				return r;
+			}
+
+			uint32_t word = value;
+
+			memcpy(&data[c], &word, sizeof(word));
+		}
+		return 0;
+	}
 
 	/** Register interrupt callback */
 	virtual void onIRQ(std::function<void()>) = 0;
@@ -0,0 +1,342 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+/**
+ * Scheduler for callbacks in simulated time.
+ **/
+#pragma once
+
+#include <stdint.h>
+
+#include <functional>
+
+class TimingWheel;
+
+/**
+ * \brief Event scheduled on a TimingWheel
+ * \details Owned by the caller (usually a member of an instrument) so that
+ * scheduling never allocates. An event may be cancelled or rescheduled at
+ * any time, including from within its own callback.
+ **/
+class TimingEvent {
+    public:
+	TimingEvent() : next(this), prev(this), due(0), period(0)
+	{
+	}
+	explicit TimingEvent(std::function<void()> fn) : TimingEvent()
+	{
+		cb = std::move(fn);
+	}
+	TimingEvent(const TimingEvent &) = delete;
+	TimingEvent &operator=(const TimingEvent &) = delete;
+	~TimingEvent()
+	{
+		unlink();
+	}
+	/** Returns true while the event is scheduled */
+	bool pending() const
+	{
+		return next != this;
+	}
+	/** Called when the event expires */
+	std::function<void()> cb;
+
+    private:
+	friend class TimingWheel;
+
+	void unlink()
+	{
+		prev->next = next;
+		next->prev = prev;
+		next = prev = this;
+	}
+
+	TimingEvent *next;
+	TimingEvent *prev;
+	/** Expiry in ticks */
+	uint64_t due;
+	/** Period in ticks (0 for one shot events) */
+	uint64_t period;
+};
+
+/**
+ * \brief Hierarchical timing wheel
+ * \details
+ *		Four levels of 256 slots each cover 2^32 ticks ahead of the current
+ *		time. Events further out wait in an overflow list. An event is kept
+ *		in the level of the highest byte in which its expiry differs from
+ *		the current time, so insert and cancel are O(1) and every event is
+ *		moved down at most once per level before it expires. Each level has
+ *		an occupancy bitmap so that run() jumps straight to the next slot
+ *		holding events instead of stepping through idle ticks.
+ *
+ *		Not thread safe: the container only uses it with its lock held.
+ **/
+class TimingWheel {
+    public:
+	/** Number of levels */
+	static const unsigned LEVELS = 4;
+	/** Slots per level */
+	static const unsigned SLOTS = 256;
+
+	/** \param resolution_ns length of one tick in nanoseconds */
+	explicit TimingWheel(uint64_t resolution_ns = 1000) : resolution(resolution_ns), ticks(0)
+	{
+		for (unsigned l = 0; l < LEVELS; l++) {
+			for (unsigned s = 0; s < SLOTS / 64; s++) {
+				occupied[l][s] = 0;
+			}
+		}
+	}
+	~TimingWheel()
+	{
+		for (unsigned l = 0; l < LEVELS; l++) {
+			for (unsigned s = 0; s < SLOTS; s++) {
+				while (slots[l][s].pending()) {
+					slots[l][s].next->unlink();
+				}
+			}
+		}
+		while (overflow.pending()) {
+			overflow.next->unlink();
+		}
+	}
+
+	/**
+	 * \brief Schedule an event
+	 * \details Reschedules the event if it is already pending.
+	 * \param ev event to schedule
+	 * \param delay_ns simulated time from now until the event expires (rounded up to ticks)
+	 * \param period_ns time between following expirations (0 for a one shot event)
+	 **/
+	void schedule(TimingEvent *ev, uint64_t delay_ns, uint64_t period_ns = 0)
+	{
+		ev->unlink();
+		ev->due = this->ticks + toTicks(delay_ns);
+		ev->period = toTicks(period_ns);
+		if (period_ns && ev->period == 0) {
+			ev->period = 1;
+		}
+		insert(ev);
+	}
+
+	void cancel(TimingEvent *ev)
+	{
+		ev->unlink();
+	}
+
+	/** Current simulated time in nanoseconds */
+	uint64_t now() const
+	{
+		return this->ticks * this->resolution;
+	}
+
+	/**
+	 * \brief Time of the next event
+	 * \details Finds the first occupied slot through the bitmaps. Only when
+	 * that slot is in a higher level are its events scanned for the earliest.
+	 * \returns time in nanoseconds or UINT64_MAX when nothing is scheduled
+	 **/
+	uint64_t next() const
+	{
+		uint64_t t = nextTick();
+
+		return t == UINT64_MAX ? t : t * this->resolution;
+	}
+
+	/**
+	 * \brief Fire all events that expire up to and including time ns
+	 * \details Events fire in order of expiry and the current time is set to
+	 * the expiry of each event before its callback runs. Callbacks may
+	 * schedule and cancel events.
+	 **/
+	void run(uint64_t ns)
+	{
+		uint64_t target = ns / this->resolution;
+
+		while (this->ticks <= target) {
+			uint64_t t = nextTick();
+
+			if (t > target) {
+				break;
+			}
+			moveTo(t);
+			expire();
+		}
+		if (target > this->ticks) {
+			moveTo(target);
+		}
+	}
+
+    private:
+	uint64_t toTicks(uint64_t ns) const
+	{
+		return (ns + this->resolution - 1) / this->resolution;
+	}
+
+	static unsigned slotOf(uint64_t t, unsigned level)
+	{
+		return (t >> (8 * level)) & (SLOTS - 1);
+	}
+
+	void link(TimingEvent *head, TimingEvent *ev)
+	{
+		ev->prev = head->prev;
+		ev->next = head;
+		head->prev->next = ev;
+		head->prev = ev;
+	}
+
+	void insert(TimingEvent *ev)
+	{
+		uint64_t diff = ev->due ^ this->ticks;
+		unsigned level = 0;
+
+		// expired events go into the current slot
+		if (ev->due > this->ticks && diff) {
+			level = (63 - __builtin_clzll(diff)) / 8;
+		}
+		if (level >= LEVELS) {
+			link(&this->overflow, ev);
+			return;
+		}
+
+		unsigned slot = ev->due > this->ticks ? slotOf(ev->due, level) :
+							slotOf(this->ticks, 0);
+
+		link(&this->slots[level][slot], ev);
+		this->occupied[level][slot / 64] |= 1ULL << (slot % 64);
+	}
+
+	/** First occupied slot of a level at or after slot from, or SLOTS */
+	unsigned findSlot(unsigned level, unsigned from) const
+	{
+		for (unsigned w = from / 64; w < SLOTS / 64; w++) {
+			uint64_t bits = this->occupied[level][w];
+
+			if (w == from / 64) {
+				bits &= ~0ULL << (from % 64);
+			}
+			if (bits) {
+				return w * 64 + __builtin_ctzll(bits);
+			}
+		}
+		return SLOTS;
+	}
+
+	/** Earliest expiry in a list of events */
+	static uint64_t earliest(const TimingEvent *head)
+	{
+		uint64_t due = UINT64_MAX;
+
+		for (const TimingEvent *ev = head->next; ev != head; ev = ev->next) {
+			if (ev->due < due) {
+				due = ev->due;
+			}
+		}
+		return due;
+	}
+
+	/** Tick of the next event */
+	uint64_t nextTick() const
+	{
+		for (unsigned l = 0; l < LEVELS; l++) {
+			// slots of higher levels at the current position were moved down already
+			unsigned from = slotOf(this->ticks, l) + (l ? 1 : 0);
+
+			for (unsigned slot = findSlot(l, from); slot < SLOTS;
+			     slot = findSlot(l, slot + 1)) {
+				const TimingEvent *head = &this->slots[l][slot];
+
+				// cancelled events leave their bit set until the slot is reached
+				if (!head->pending()) {
+					continue;
+				}
+				if (l == 0) {
+					return (this->ticks >> 8 << 8) | slot;
+				}
+				// the first occupied slot holds the next event but it can be anywhere in it
+				return earliest(head);
+			}
+		}
+		return earliest(&this->overflow);
+	}
+
+	/** Set the current time and move events of the slots it enters down */
+	void moveTo(uint64_t t)
+	{
+		uint64_t from = this->ticks;
+
+		this->ticks = t;
+		if ((from >> (8 * LEVELS)) != (t >> (8 * LEVELS))) {
+			cascade(&this->overflow);
+		}
+		for (int l = LEVELS - 1; l > 0; l--) {
+			if ((from >> (8 * l)) != (t >> (8 * l))) {
+				unsigned slot = slotOf(t, l);
+
+				this->occupied[l][slot / 64] &= ~(1ULL << (slot % 64));
+				cascade(&this->slots[l][slot]);
+			}
+		}
+	}
+
+	/** Reinsert all events of a list relative to the current time */
+	void cascade(TimingEvent *head)
+	{
+		TimingEvent list;
+
+		// take the whole list first as events may land in the same slot again
+		if (!head->pending()) {
+			return;
+		}
+		list.next = head->next;
+		list.prev = head->prev;
+		list.next->prev = &list;
+		list.prev->next = &list;
+		head->next = head->prev = head;
+
+		while (list.pending()) {
+			TimingEvent *ev = list.next;
+
+			ev->unlink();
+			insert(ev);
+		}
+	}
+
+	/** Fire all events in the current slot of the lowest level */
+	void expire()
+	{
+		unsigned slot = slotOf(this->ticks, 0);
+		TimingEvent *head = &this->slots[0][slot];
+
+		// callbacks may add events to this slot so it is emptied one by one
+		while (head->pending()) {
+			TimingEvent *ev = head->next;
+
+			ev->unlink();
+			if (ev->period) {
+				ev->due = this->ticks + ev->period;
+				insert(ev);
+			}
+			if (ev->cb) {
+				ev->cb();
+			}
+		}
+		this->occupied[0][slot / 64] &= ~(1ULL << (slot % 64));
+	}
+
+	/** Length of a tick in nanoseconds */
+	uint64_t resolution;
+	/** Current time in ticks */
+	uint64_t ticks;
+	TimingEvent slots[LEVELS][SLOTS];
+	/** Occupancy bitmap of each level */
+	uint64_t occupied[LEVELS][SLOTS / 64];
+	/** Events beyond the range of the top level */
+	TimingEvent overflow;
+};
@@ -0,0 +1,312 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+#pragma once
+#include "IPeripheral.h"
+#include "InternalBus.h"
+
+/** AXI response codes */
+#define AXI_RESP_OKAY 0
+#define AXI_RESP_EXOKAY 1
+#define AXI_RESP_SLVERR 2
+#define AXI_RESP_DECERR 3
+
+/**
+ * \brief Bus controller for Verilated AXI4-Lite peripherals
+ * \details
+ *		The model is expected to have the usual slave ports prefixed with
+ *		axi_ (axi_aclk, axi_aresetn, axi_awaddr, axi_awvalid, axi_awready,
+ *		axi_wdata, axi_wstrb, axi_wvalid, axi_wready, axi_bresp, axi_bvalid,
+ *		axi_bready, axi_araddr, axi_arvalid, axi_arready, axi_rdata,
+ *		axi_rresp, axi_rvalid and axi_rready).
+ *
+ *		The five channels are driven independently. Address and data of a
+ *		write are offered as soon as the slave can take them, without
+ *		waiting for the response to the previous write, so a block of
+ *		writes overlaps in the slave instead of costing a full round trip
+ *		per word. The same goes for reads, and transfer() runs reads and
+ *		writes at the same time. The number of transactions in flight on
+ *		each side is limited by setOutstanding().
+ **/
+template <typename T> class AxiLiteSlave : public IPeripheral, public ClockedTargetBus {
+    protected:
+	T *dev;
+	std::function<void()> cbOnIRQ;
+	/** Transactions that may be waiting for a response on each side */
+	unsigned maxOutstanding;
+	/** Clock cycles run */
+	uint64_t cycleCount;
+
+	/** State of the interrupt output of the model (checked by pollIRQ()) */
+	virtual bool irqLine()
+	{
+		return false;
+	}
+
+    public:
+	AxiLiteSlave(T *dev)
+	{
+		this->dev = dev;
+		this->maxOutstanding = 8;
+		this->cycleCount = 0;
+		// the reset input is active low so the model starts out in reset
+		reset();
+	}
+
+	~AxiLiteSlave()
+	{
+	}
+
+	/**
+	 * \brief Limit the number of transactions in flight
+	 * \details With a limit of one every access waits for its response
+	 * before the next one is issued.
+	 **/
+	void setOutstanding(unsigned count)
+	{
+		this->maxOutstanding = count ? count : 1;
+	}
+
+	/** Number of clock cycles run through the model */
+	uint64_t cycles() const
+	{
+		return this->cycleCount;
+	}
+
+	/**
+	 * \brief Bring the model up to date and check its interrupt output
+	 * \details Calls the interrupt callback while the line is high.
+	 * \returns state of the interrupt line
+	 **/
+	bool pollIRQ()
+	{
+		catchUp();
+
+		bool line = irqLine();
+
+		if (line && cbOnIRQ) {
+			cbOnIRQ();
+		}
+		return line;
+	}
+
+	/**
+	 * \brief Run writes and reads of consecutive words on both channels at once
+	 * \param waddr byte address of the first word to write
+	 * \param out words to write
+	 * \param wcount number of words to write
+	 * \param raddr byte address of the first word to read
+	 * \param in buffer receiving the words read
+	 * \param rcount number of words to read
+	 * \param strb byte lanes written in every word
+	 * \returns 0 on success or negative on error
+	 * \retval -EIO the slave returned an error response for one of the words
+	 * \retval -ETIMEDOUT the slave stopped responding
+	 **/
+	int transfer(uint64_t waddr, const uint8_t *out, size_t wcount, uint64_t raddr,
+		     uint8_t *in, size_t rcount, uint8_t strb = 0xF)
+	{
+		// handshakes done on each channel
+		size_t aw = 0, w = 0, b = 0, ar = 0, r = 0;
+		int timeout = 20;
+		int err = 0;
+
+		catchUp();
+		dev->axi_bready = 1;
+		dev->axi_rready = 1;
+		while (b < wcount || r < rcount) {
+			dev->axi_awvalid = aw < wcount && aw - b < this->maxOutstanding;
+			dev->axi_awaddr = waddr + aw * 4;
+			dev->axi_wvalid = w < wcount && w - b < this->maxOutstanding;
+			if (dev->axi_wvalid) {
+				uint32_t word;
+
+				memcpy(&word, &out[w * 4], sizeof(word));
+				dev->axi_wdata = word;
+				dev->axi_wstrb = strb;
+			}
+			dev->axi_arvalid = ar < rcount && ar - r < this->maxOutstanding;
+			dev->axi_araddr = raddr + ar * 4;
+
+			// settle the ready outputs for the new requests and sample all
+			// handshakes right before the rising edge
+			dev->eval();
+
+			bool awdone = dev->axi_awvalid && dev->axi_awready;
+			bool wdone = dev->axi_wvalid && dev->axi_wready;
+			bool bdone = dev->axi_bvalid && b < wcount;
+			bool ardone = dev->axi_arvalid && dev->axi_arready;
+			bool rdone = dev->axi_rvalid && r < rcount;
+
+			if (bdone && dev->axi_bresp != AXI_RESP_OKAY) {
+				err = -EIO;
+			}
+			if (rdone) {
+				uint32_t word = dev->axi_rdata;
+
+				memcpy(&in[r * 4], &word, sizeof(word));
+				if (dev->axi_rresp != AXI_RESP_OKAY) {
+					err = -EIO;
+				}
+			}
+			tick();
+			aw += awdone;
+			w += wdone;
+			b += bdone;
+			ar += ardone;
+			r += rdone;
+			if (awdone || wdone || bdone || ardone || rdone) {
+				timeout = 20;
+			} else if (--timeout == 0) {
+				err = -ETIMEDOUT;
+				break;
+			}
+		}
+
+		dev->axi_awvalid = 0;
+		dev->axi_wvalid = 0;
+		dev->axi_arvalid = 0;
+		dev->axi_bready = 0;
+		dev->axi_rready = 0;
+		dev->eval();
+		return err;
+	}
+
+	virtual void tick()
+	{
+		tick(1);
+	}
+
+	/** Run the owed cycles followed by steps more */
+	virtual void tick(uint64_t steps)
+	{
+		steps += this->owed;
+		this->owed = 0;
+		while (steps > 0) {
+			dev->axi_aclk = 1;
+			dev->eval();
+			dev->axi_aclk = 0;
+			dev->eval();
+			this->cycleCount++;
+			steps--;
+		}
+	}
+
+	virtual void advance(uint64_t ns) override
+	{
+		advanceClock(ns);
+	}
+
+	/** Run the cycles of the quantum and check the interrupt output */
+	virtual void endQuantum() override
+	{
+		pollIRQ();
+	}
+
+	virtual int write(uint64_t addr, uint64_t value)
+	{
+		uint32_t word = value;
+
+		return transfer(addr, (const uint8_t *)&word, 1, 0, NULL, 0);
+	}
+
+	virtual int read(uint64_t addr, uint64_t *value)
+	{
+		uint32_t word;
+		int r = transfer(0, NULL, 0, addr, (uint8_t *)&word, 1);
+
+		*value = r == 0 ? word : ~0ULL;
+		return r;
+	}
+
+	virtual void reset()
+	{
+		dev->axi_aresetn = 0;
+		tick();
+		dev->axi_aresetn = 1;
+		tick();
+	}
+
+    public: /* IPeripheral interface */
+	virtual int write32(uint64_t addr, uint64_t data) override
+	{
+		return write(addr & ~3ULL, data);
+	}
+
+	virtual int read32(uint64_t addr, uint64_t *data) override
+	{
+		return read(addr & ~3ULL, data);
+	}
+
+	// Narrow writes only strobe the lanes they cover (little endian lane
+	// order). Reads always return a whole word which is shifted down.
+	virtual int write8(uint64_t addr, uint64_t data) override
+	{
+		uint32_t word = (data & 0xFF) << (addr & 3) * 8;
+
+		return transfer(addr & ~3ULL, (const uint8_t *)&word, 1, 0, NULL, 0,
+				0x1 << (addr & 3));
+	}
+
+	virtual int read8(uint64_t addr, uint64_t *data) override
+	{
+		int r = read(addr & ~3ULL, data);
+
+		if (r == 0) {
+			*data = (*data >> (addr & 3) * 8) & 0xFF;
+		}
+		return r;
+	}
+
+	virtual int write16(uint64_t addr, uint64_t data) override
+	{
+		// a halfword may not straddle two words
+		if (addr & 1) {
+			return -EINVAL;
+		}
+
+		uint32_t word = (data & 0xFFFF) << (addr & 3) * 8;
+
+		return transfer(addr & ~3ULL, (const uint8_t *)&word, 1, 0, NULL, 0,
+				0x3 << (addr & 3));
+	}
+
+	virtual int read16(uint64_t addr, uint64_t *data) override
+	{
+		if (addr & 1) {
+			return -EINVAL;
+		}
+
+		int r = read(addr & ~3ULL, data);
+
+		if (r == 0) {
+			*data = (*data >> (addr & 3) * 8) & 0xFFFF;
+		}
+		return r;
+	}
+
+	virtual int writeBlock(uint64_t addr, const uint8_t *data, size_t len) override
+	{
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		return transfer(addr, data, len / 4, 0, NULL, 0);
+	}
+
+	virtual int readBlock(uint64_t addr, uint8_t *data, size_t len) override
+	{
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		return transfer(0, NULL, 0, addr, data, len / 4);
+	}
+
+	virtual void onIRQ(std::function<void()> cb) override
+	{
+		cbOnIRQ = cb;
+	}
+};
@@ -15,7 +15,6 @@ class BaseBus {
 	{
 	}
 	virtual void tick(uint64_t steps) = 0;
-	virtual int timeoutTick(uint8_t *signal, uint8_t expectedValue, int timeout) = 0;
 	virtual void reset() = 0;
 
     protected:
@@ -27,6 +26,82 @@ class BaseTargetBus : public BaseBus {
 	virtual int read(uint64_t addr, uint64_t *value) = 0;
 };
 
+/**
+ * \brief Target bus clocked by simulated time
+ * \details Converts the time granted with advanceClock() into cycles of the
+ * bus clock. tick(steps) must run the owed cycles before the steps asked for.
+ **/
+class ClockedTargetBus : public BaseTargetBus {
+    public:
+	ClockedTargetBus()
+	{
+		this->clockFrequency = 0;
+		this->cycleFraction = 0;
+		this->lazyClock = true;
+		this->owed = 0;
+	}
+
+	/** Set frequency of the bus clock used to convert simulated time into cycles */
+	void setClockFrequency(uint64_t hz)
+	{
+		this->clockFrequency = hz;
+		this->cycleFraction = 0;
+	}
+
+	/**
+	 * \brief Select when simulated time is run through the model
+	 * \details Lazily clocked peripherals only record the cycles granted
+	 * by advanceClock() and run them all in one go right before the next
+	 * bus access, interrupt poll or explicit tick(). The simulator polls
+	 * the interrupt at the end of every quantum (endQuantum()), so the
+	 * cycles of a quantum split by scheduled events are run at once, on
+	 * the tick pool of the container if it has one. When disabled every
+	 * part of a quantum is run as it is granted.
+	 **/
+	void setLazyClock(bool enable)
+	{
+		this->lazyClock = enable;
+		if (!enable) {
+			catchUp();
+		}
+	}
+
+	/** Number of cycles not yet run through the model */
+	uint64_t lag() const
+	{
+		return this->owed;
+	}
+
+	/** Run the cycles owed to the model up to the current simulated time */
+	void catchUp()
+	{
+		tick(0);
+	}
+
+	/** Grant the clock as many cycles as fit into the quantum */
+	void advanceClock(uint64_t ns)
+	{
+		// whole seconds separately so that ns * Hz can not overflow
+		uint64_t t = this->cycleFraction + (ns % 1000000000ULL) * this->clockFrequency;
+
+		this->owed += (ns / 1000000000ULL) * this->clockFrequency + t / 1000000000ULL;
+		this->cycleFraction = t % 1000000000ULL;
+		if (!this->lazyClock) {
+			catchUp();
+		}
+	}
+
+    protected:
+	/** Frequency of the bus clock in Hz (zero if not clocked by simulated time) */
+	uint64_t clockFrequency;
+	/** Fraction of a clock cycle carried over between time quanta (in ns * Hz) */
+	uint64_t cycleFraction;
+	/** Only run the clock when the peripheral is observed */
+	bool lazyClock;
+	/** Cycles of simulated time that passed since the model was last evaluated */
+	uint64_t owed;
+};
+
 class BaseInitiatorBus : public BaseBus {
     public:
 	virtual void readWord(uint64_t addr, uint8_t sel) = 0;
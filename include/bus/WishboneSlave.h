@@ -9,15 +9,195 @@
 #include "IPeripheral.h"
 #include "InternalBus.h"
 
-template <typename T> class WishboneSlave : public IPeripheral, public BaseTargetBus {
+#include <algorithm>
+#include <type_traits>
+#include <utility>
+
+/** How WishboneSlave runs its bus cycles */
+enum WishboneMode {
+	/** One classic cycle per word, waiting for ack to drop after each */
+	WISHBONE_CLASSIC,
+	/** Pipelined (B4): a new request every clock unless the slave stalls */
+	WISHBONE_PIPELINED,
+	/** Classic cycles with incrementing bursts (CTI=010, linear BTE) for blocks */
+	WISHBONE_BURST,
+};
+
+/** True if the Verilated model has a wb_stall output (pipelined slave) */
+template <typename T, typename = void> struct wishbone_has_stall : std::false_type {};
+template <typename T>
+struct wishbone_has_stall<T, decltype((void)std::declval<T &>().wb_stall)> : std::true_type {};
+
+/** True if the Verilated model has wb_cti and wb_bte inputs */
+template <typename T, typename = void> struct wishbone_has_cti : std::false_type {};
+template <typename T>
+struct wishbone_has_cti<T, decltype((void)std::declval<T &>().wb_cti)> : std::true_type {};
+
+template <typename T> class WishboneSlave : public IPeripheral, public ClockedTargetBus {
     protected:
 	T *dev;
 	std::function<void()> cbOnIRQ;
+	/** Skip cycles the peripheral reports as unobservable */
+	bool fastForwardEnabled;
+	WishboneMode busMode;
+
+	/**
+	 * \brief Skip clock cycles without evaluating the model
+	 * \details Called before every clock cycle while no bus cycle is in
+	 * progress. A peripheral that is idle, or in which only a counter is
+	 * running, returns how many of the cycles it can account for without
+	 * anything observable happening (clocking the model once with the
+	 * counter advanced by all of them if it has to). The cycle after those
+	 * is evaluated as usual.
+	 * \param cycles number of cycles left to run
+	 * \returns number of cycles skipped (0 to evaluate the next cycle)
+	 **/
+	virtual uint64_t fastForward(uint64_t cycles)
+	{
+		return 0;
+	}
+
+	/** State of the interrupt output of the model (checked by pollIRQ()) */
+	virtual bool irqLine()
+	{
+		return false;
+	}
+
+	/** Run one rising and falling edge of wb_clk through the model */
+	void clockEdge()
+	{
+		dev->wb_clk = 1;
+		dev->eval();
+		dev->wb_clk = 0;
+		dev->eval();
+	}
 
     public:
+	/** Number of clock cycles run */
+	struct ClockStats {
+		/** Cycles in which the model was evaluated */
+		uint64_t evaluated;
+		/** Cycles skipped by fastForward() */
+		uint64_t skipped;
+	};
+
 	WishboneSlave(T *dev)
 	{
 		this->dev = dev;
+		this->fastForwardEnabled = true;
+		this->busMode = WISHBONE_CLASSIC;
+		this->clockStats = ClockStats{ 0, 0 };
+	}
+
+	/** Evaluate every clock cycle (for example while tracing waveforms) when disabled */
+	void setFastForward(bool enable)
+	{
+		this->fastForwardEnabled = enable;
+	}
+
+	ClockStats clock() const
+	{
+		return this->clockStats;
+	}
+
+	/**
+	 * \brief Select the kind of bus cycles
+	 * \details In pipelined and burst mode block accesses run as a single
+	 * bus cycle and no access waits for ack to drop before returning.
+	 * Pipelined mode only overlaps requests with slaves that have a
+	 * wb_stall output, other slaves take one request per ack.
+	 **/
+	void setBusMode(WishboneMode mode)
+	{
+		this->busMode = mode;
+	}
+
+	/**
+	 * \brief Run consecutive word accesses in a single bus cycle
+	 * \param addr byte address of the first word
+	 * \param count number of words
+	 * \param out words to write (NULL to read)
+	 * \param in buffer receiving the words read
+	 * \param sel byte lanes driven in every word
+	 **/
+	int transfer(uint64_t addr, size_t count, const uint8_t *out, uint8_t *in,
+		     uint8_t sel = 0xF)
+	{
+		bool pipelined = this->busMode == WISHBONE_PIPELINED && wishbone_has_stall<T>::value;
+		size_t issued = 0;
+		size_t acked = 0;
+		int timeout = 20;
+
+		catchUp();
+		dev->wb_we = out != NULL;
+		dev->wb_sel = sel;
+		dev->wb_cyc = 1;
+		while (acked < count) {
+			bool accept = false;
+
+			if (issued < count) {
+				dev->wb_stb = 1;
+				dev->wb_addr = (addr >> 2) + issued;
+				if (out) {
+					uint32_t word;
+
+					memcpy(&word, &out[issued * 4], sizeof(word));
+					dev->wb_wr_dat = word;
+				}
+				// bursts announce whether another word follows
+				if (this->busMode == WISHBONE_BURST) {
+					setCycleType(dev, issued + 1 < count ? 2 : 7, wishbone_has_cti<T>());
+				}
+				accept = pipelined && !stalled(dev, wishbone_has_stall<T>());
+			} else {
+				dev->wb_stb = 0;
+			}
+			tick();
+			if (dev->wb_ack) {
+				if (in) {
+					uint32_t word = dev->wb_rd_dat;
+
+					memcpy(&in[acked * 4], &word, sizeof(word));
+				}
+				acked++;
+				// without pipelining the slave takes a request by acknowledging it
+				if (!pipelined) {
+					issued++;
+				}
+			}
+			if (accept) {
+				issued++;
+			}
+			if (dev->wb_ack || accept) {
+				timeout = 20;
+			} else if (--timeout == 0) {
+				break;
+			}
+		}
+
+		dev->wb_cyc = 0;
+		dev->wb_stb = 0;
+		dev->wb_we = 0;
+		dev->wb_sel = 0;
+		setCycleType(dev, 0, wishbone_has_cti<T>());
+		return acked < count ? -ETIMEDOUT : 0;
+	}
+
+	/**
+	 * \brief Bring the model up to date and check its interrupt output
+	 * \details Calls the interrupt callback while the line is high.
+	 * \returns state of the interrupt line
+	 **/
+	bool pollIRQ()
+	{
+		catchUp();
+
+		bool line = irqLine();
+
+		if (line && cbOnIRQ) {
+			cbOnIRQ();
+		}
+		return line;
 	}
 
 	~WishboneSlave()
@@ -29,20 +209,67 @@ template <typename T> class WishboneSlave : public IPeripheral, public BaseTarge
 		tick(1);
 	}
 
+	virtual void advance(uint64_t ns) override
+	{
+		advanceClock(ns);
+	}
+
+	/** Run the cycles of the quantum and check the interrupt output */
+	virtual void endQuantum() override
+	{
+		pollIRQ();
+	}
+
+	/** Run the owed cycles followed by steps more */
 	virtual void tick(uint64_t steps)
 	{
-		for (uint32_t i = 0; i < steps; i++) {
-			dev->wb_clk = 1;
-			dev->eval();
-			dev->wb_clk = 0;
-			dev->eval();
+		steps += this->owed;
+		this->owed = 0;
+		while (steps > 0) {
+			// a bus cycle in progress always needs the model
+			if (this->fastForwardEnabled && !dev->wb_cyc) {
+				uint64_t skipped = std::min(fastForward(steps), steps);
+
+				if (skipped) {
+					this->clockStats.skipped += skipped;
+					steps -= skipped;
+					continue;
+				}
+			}
+			clockEdge();
+			this->clockStats.evaluated++;
+			steps--;
 		}
 	}
 
 	virtual int write(uint64_t addr, uint64_t value)
 	{
+		return writeLanes(addr, value, 0xF);
+	}
+
+	virtual int read(uint64_t addr, uint64_t *value)
+	{
+		uint32_t word;
+		int r = readLanes(addr, 0xF, &word);
+
+		*value = r == 0 ? word : ~0ULL;
+		return r;
+	}
+
+	/**
+	 * \brief Write the selected byte lanes of the word at addr in one bus cycle
+	 * \param addr byte address (the two lowest bits are ignored)
+	 * \param value word with the bytes in their lanes
+	 * \param sel wb_sel mask of the lanes to write
+	 **/
+	int writeLanes(uint64_t addr, uint32_t value, uint8_t sel)
+	{
+		if (this->busMode != WISHBONE_CLASSIC) {
+			return transfer(addr, 1, (const uint8_t *)&value, NULL, sel);
+		}
+		catchUp();
 		this->dev->wb_we = 1;
-		this->dev->wb_sel = 0xF;
+		this->dev->wb_sel = sel;
 		this->dev->wb_cyc = 1;
 		this->dev->wb_stb = 1;
 		//  According to WishboneSlave B4 spec when using 32 bit bus with byte granularity
@@ -65,10 +292,20 @@ template <typename T> class WishboneSlave : public IPeripheral, public BaseTarge
 		return 0;
 	}
 
-	virtual int read(uint64_t addr, uint64_t *value)
+	/**
+	 * \brief Read the word at addr in one bus cycle with only some byte lanes selected
+	 * \param addr byte address (the two lowest bits are ignored)
+	 * \param sel wb_sel mask of the lanes to read
+	 * \param value receives the whole word as returned by the slave
+	 **/
+	int readLanes(uint64_t addr, uint8_t sel, uint32_t *value)
 	{
+		if (this->busMode != WISHBONE_CLASSIC) {
+			return transfer(addr, 1, NULL, (uint8_t *)value, sel);
+		}
+		catchUp();
 		dev->wb_we = 0;
-		dev->wb_sel = 0xF;
+		dev->wb_sel = sel;
 		dev->wb_cyc = 1;
 		dev->wb_stb = 1;
 		dev->wb_addr = addr >> 2;
@@ -77,7 +314,7 @@ template <typename T> class WishboneSlave : public IPeripheral, public BaseTarge
 			return -ETIMEDOUT;
 		}
 
-		uint64_t result = dev->wb_rd_dat;
+		uint32_t result = dev->wb_rd_dat;
 
 		dev->wb_cyc = 0;
 		dev->wb_stb = 0;
@@ -121,33 +358,102 @@ template <typename T> class WishboneSlave : public IPeripheral, public BaseTarge
 		return 0;
 	}
 
+    private:
+	template <typename U> static void setCycleType(U *dev, uint8_t cti, std::true_type)
+	{
+		dev->wb_cti = cti;
+		dev->wb_bte = 0;
+	}
+	template <typename U> static void setCycleType(U *dev, uint8_t cti, std::false_type)
+	{
+	}
+	/** Settle the combinational logic for the new request and sample wb_stall */
+	template <typename U> static bool stalled(U *dev, std::true_type)
+	{
+		dev->eval();
+		return dev->wb_stall;
+	}
+	template <typename U> static bool stalled(U *dev, std::false_type)
+	{
+		return true;
+	}
+
+	ClockStats clockStats;
+
     public: /* IPeripheral interface */
 	virtual int write32(uint64_t addr, uint64_t data) override
 	{
 		return write(addr, data);
 	}
-	virtual int write16(uint64_t addr, uint64_t data) override
+
+	virtual int read32(uint64_t addr, uint64_t *data) override
 	{
-		return -ENOTSUP;
+		return read(addr, data);
 	}
+
+	// Narrow accesses drive only the byte lanes they cover (little endian
+	// lane order) so each one is a single bus cycle without read-modify-write.
 	virtual int write8(uint64_t addr, uint64_t data) override
 	{
-		return -ENOTSUP;
+		unsigned shift = (addr & 3) * 8;
+
+		return writeLanes(addr, (data & 0xFF) << shift, 0x1 << (addr & 3));
 	}
 
-	virtual int read32(uint64_t addr, uint64_t *data) override
+	virtual int read8(uint64_t addr, uint64_t *data) override
 	{
-		return read(addr, data);
+		uint32_t word;
+		int r = readLanes(addr, 0x1 << (addr & 3), &word);
+
+		*data = r == 0 ? (word >> (addr & 3) * 8) & 0xFF : ~0ULL;
+		return r;
+	}
+
+	virtual int write16(uint64_t addr, uint64_t data) override
+	{
+		unsigned shift = (addr & 3) * 8;
+
+		// a halfword may not straddle two words
+		if (addr & 1) {
+			return -EINVAL;
+		}
+		return writeLanes(addr, (data & 0xFFFF) << shift, 0x3 << (addr & 3));
 	}
 
 	virtual int read16(uint64_t addr, uint64_t *data) override
 	{
-		return -ENOTSUP;
+		uint32_t word;
+
+		if (addr & 1) {
+			return -EINVAL;
+		}
+
+		int r = readLanes(addr, 0x3 << (addr & 3), &word);
+
+		*data = r == 0 ? (word >> (addr & 3) * 8) & 0xFFFF : ~0ULL;
+		return r;
 	}
 
-	virtual int read8(uint64_t addr, uint64_t *data) override
+	virtual int writeBlock(uint64_t addr, const uint8_t *data, size_t len) override
+	{
+		if (this->busMode == WISHBONE_CLASSIC) {
+			return IPeripheral::writeBlock(addr, data, len);
+		}
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		return len ? transfer(addr, len / 4, data, NULL) : 0;
+	}
+
+	virtual int readBlock(uint64_t addr, uint8_t *data, size_t len) override
 	{
-		return -ENOTSUP;
+		if (this->busMode == WISHBONE_CLASSIC) {
+			return IPeripheral::readBlock(addr, data, len);
+		}
+		if ((addr | len) & 3) {
+			return -EINVAL;
+		}
+		return len ? transfer(addr, len / 4, NULL, data) : 0;
 	}
 
 	/** Register interrupt callback */
@@ -12,6 +12,8 @@
  * @{
  **/
 
+#include <stddef.h>
+
 #include "protocol.h"
 
 struct instrulink;
@@ -40,6 +42,33 @@ void instrulink_free(struct instrulink **self);
  **/
 int instrulink_connect(struct instrulink *self, int mainPort, int irqPort, const char *ip);
 
+/**
+ * \brief Connect to instrulink over unix domain sockets
+ * \details Both sockets are SOCK_SEQPACKET so every frame arrives as one
+ * message. A path starting with '@' refers to the abstract namespace.
+ * \param self pointer to instrulink instance
+ * \param mainPath path of the main socket
+ * \param irqPath path of the irq socket
+ * \returns 0 on success or negative on error
+ * \retval -EINVAL invalid path
+ * \retval -ECONNREFUSED connection was refused
+ **/
+int instrulink_connect_unix(struct instrulink *self, const char *mainPath, const char *irqPath);
+
+/**
+ * \brief Connect to instrulink through a shared memory segment
+ * \details The segment is created and initialized by the simulator and holds
+ * the request, response and irq rings described in shm.h. Receives and sends
+ * fail with -EIO once the simulator has disconnected or its process is gone.
+ * \param self pointer to instrulink instance
+ * \param name POSIX shared memory object name or "fd:N" for a memfd inherited
+ * as file descriptor N
+ * \returns 0 on success or negative on error
+ * \retval -EINVAL segment is too small or not initialized
+ * \retval -ECONNREFUSED segment could not be opened
+ **/
+int instrulink_connect_shm(struct instrulink *self, const char *name);
+
 /**
  * \brief Close connections to instrulink and cleanup
  * \param self pointer to instrulink instance
@@ -47,6 +76,110 @@ int instrulink_connect(struct instrulink *self, int mainPort, int irqPort, const
  **/
 int instrulink_disconnect(struct instrulink *self);
 
+/**
+ * \brief Stop a thread blocked receiving on a channel that can not be polled
+ * \details The blocked receive and every later one returns -EIO. Only the shm
+ * transport needs this (the simulator sees it as a disconnect). Safe to call
+ * from any thread.
+ * \param self instrulink instance
+ **/
+void instrulink_shutdown(struct instrulink *self);
+
+/**
+ * \brief Returns the descriptor of the main channel for use with poll or epoll
+ * \details The descriptor becomes readable when the simulator sends data.
+ * Requests that were already received may be buffered so instrulink_pending()
+ * must be checked before waiting on the descriptor again.
+ * \param self instrulink instance
+ * \returns file descriptor or -1 if the transport can not be polled (shm)
+ **/
+int instrulink_fd(struct instrulink *self);
+
+/**
+ * \brief Returns the descriptor of the interrupt channel for use with poll or epoll
+ * \details Only interrupt notifications are sent on this channel. The descriptor
+ * is watched for hangup so that a simulator closing it is noticed.
+ * \param self instrulink instance
+ * \returns file descriptor or -1 if the transport can not be polled (shm)
+ **/
+int instrulink_irq_fd(struct instrulink *self);
+
+/** How waits for data on the main channel were satisfied */
+struct instrulink_wait_stats {
+	/** Data arrived while busy polling (or was already there) */
+	uint64_t polled;
+	/** Had to block in the kernel */
+	uint64_t blocked;
+};
+
+/**
+ * \brief Configure hybrid waiting on the main channel
+ * \details Before blocking, the main channel (or the request ring of the shm
+ * transport) is polled without blocking for up to us microseconds. This
+ * trades a busy core for the scheduler wakeup on every register access.
+ * \param self instrulink instance
+ * \param us time to spin in microseconds (0 always blocks)
+ **/
+void instrulink_set_busy_poll(struct instrulink *self, uint32_t us);
+
+/**
+ * \brief Get statistics on how waits for requests were satisfied
+ * \param self instrulink instance
+ * \param stats receives the statistics
+ **/
+void instrulink_get_wait_stats(struct instrulink *self, struct instrulink_wait_stats *stats);
+
+/**
+ * \brief Touch all buffers used on the request path
+ * \details Used in real-time mode so that the first requests do not page fault.
+ * \param self instrulink instance
+ **/
+void instrulink_prefault(struct instrulink *self);
+
+/**
+ * \brief Check whether a request can be received without blocking
+ * \details A request counts as complete once the operations of a batch or
+ * the payload of a block write that follow it are buffered as well.
+ * \param self instrulink instance
+ * \returns non-zero if a complete request is buffered
+ **/
+int instrulink_pending(struct instrulink *self);
+
+/**
+ * \brief Make the main channel descriptor non-blocking
+ * \details Used when one thread polls many connections. Data is then only
+ * taken in by instrulink_receive() and requests are only handed out once
+ * instrulink_pending() reports them complete, so a simulator that stops in
+ * the middle of a request never blocks the thread. Blocking receives and
+ * sends still work and wait for the descriptor with poll().
+ * \param self instrulink instance
+ * \returns 0 on success
+ * \retval -ENOTSUP the transport can not be polled (shm)
+ **/
+int instrulink_set_nonblocking(struct instrulink *self);
+
+/**
+ * \brief Buffer whatever has arrived on the main channel without blocking
+ * \details Partial requests are kept and completed by later calls.
+ * \param self instrulink instance
+ * \returns 0 on success (check instrulink_pending() for complete requests)
+ * \retval -EIO the simulator closed the connection or it failed
+ * \retval -ENOTSUP the transport can not be polled (shm)
+ **/
+int instrulink_receive(struct instrulink *self);
+
+/**
+ * \brief Send responses held back while more requests were buffered
+ * \details Responses are coalesced while instrulink_pending() reports more
+ * requests, and a request that is not answered (a posted write) does not
+ * send them. A blocking receive flushes before it waits; a thread polling
+ * the descriptor must call this once instrulink_pending() reports nothing.
+ * \param self instrulink instance
+ * \returns 0 on success
+ * \retval -EIO the connection failed
+ **/
+int instrulink_flush(struct instrulink *self);
+
 /**
  * \brief Receives a packet from instrulink (blocking)
  * \param self instrulink instance
@@ -64,14 +197,59 @@ int instrulink_wait_request(struct instrulink *self, struct instrulink_packet *r
  **/
 int instrulink_send_response(struct instrulink *self, struct instrulink_packet *res);
 
+/**
+ * \brief Receives the operations of a batch request (blocking)
+ * \details Must be called after instrulink_wait_request returned a
+ * MSG_TYPE_BATCH header. The number of operations is the value of the header.
+ * \param self instrulink instance
+ * \param ops array receiving the operations
+ * \param count number of operations to receive
+ * \returns 0 on success and negative error on failure
+ **/
+int instrulink_wait_batch(struct instrulink *self, struct instrulink_packet *ops, size_t count);
+
+/**
+ * \brief Sends the response to a batch request as a single frame
+ * \param self instrulink instance
+ * \param res array of responses, one per operation of the request
+ * \param count number of responses
+ * \returns 0 on success and negative error on failure
+ **/
+int instrulink_send_batch_response(struct instrulink *self, struct instrulink_packet *res,
+				   size_t count);
+
+/**
+ * \brief Receives the payload of a block write request (blocking)
+ * \details Must be called after instrulink_wait_request returned a
+ * MSG_TYPE_WRITE_BLOCK header. The payload length is the value of the header.
+ * \param self instrulink instance
+ * \param data buffer receiving the payload
+ * \param len payload length in bytes
+ * \returns 0 on success and negative error on failure
+ **/
+int instrulink_wait_block(struct instrulink *self, void *data, size_t len);
+
+/**
+ * \brief Sends a response followed by a block of payload as a single frame
+ * \param self instrulink instance
+ * \param res response header
+ * \param data payload
+ * \param len payload length in bytes
+ * \returns 0 on success and negative error on failure
+ **/
+int instrulink_send_block_response(struct instrulink *self, struct instrulink_packet *res,
+				   const void *data, size_t len);
+
 /**
  * \brief Sends an interrupt notification.
- * \details Currently you can only raise a request and application should then
- * check what needs to be done by reading interrupt flags.
+ * \details Several lines can be raised by one notification so that the
+ * simulator can dispatch to the right handlers without polling every
+ * instrument for its interrupt flags.
  * \param self instrulink instance
+ * \param lines bitmask of raised interrupt lines (bit n is line n)
  * \returns 0 on success and negative error on failure
  **/
-int instrulink_irq_notify(struct instrulink *self);
+int instrulink_irq_notify(struct instrulink *self, uint64_t lines);
 
 /*!
  * @}
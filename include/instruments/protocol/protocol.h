@@ -9,6 +9,11 @@
 
 #include <stdint.h>
 
+/** Maximum number of operations carried by a single MSG_TYPE_BATCH request */
+#define INSTRULINK_BATCH_MAX 64
+/** Maximum payload of a single MSG_TYPE_READ_BLOCK or MSG_TYPE_WRITE_BLOCK request */
+#define INSTRULINK_BLOCK_MAX 16384
+
 /** Instrulink packet */
 struct instrulink_packet {
 	/** Packet type (instrulink_message_type) */
@@ -23,7 +28,12 @@ struct instrulink_packet {
 enum instrulink_message_type {
 	/** Invalid message */
 	MSG_TYPE_INVALID = 0,
-	/** Standard "tick" message */
+	/**
+	 * Grant a quantum of simulated time. The length of the quantum in
+	 * nanoseconds is in value. The instrument advances all of its models
+	 * by that amount and answers with MSG_TYPE_OK carrying its total
+	 * simulated time in nanoseconds in value.
+	 */
 	MSG_TYPE_TICK_CLOCK = 1,
 	/** Write value to address */
 	MSG_TYPE_WRITE32 = 2,
@@ -31,7 +41,10 @@ enum instrulink_message_type {
 	MSG_TYPE_READ32 = 3,
 	/** Reset the device */
 	MSG_TYPE_RESET = 4,
-	/** Interrupt request */
+	/**
+	 * Interrupt request. value holds a bitmask of the interrupt lines that
+	 * were raised since the previous MSG_TYPE_IRQ (bit n is line n).
+	 */
 	MSG_TYPE_IRQ = 5,
 	/** Error response */
 	MSG_TYPE_ERROR = 6,
@@ -49,4 +62,46 @@ enum instrulink_message_type {
 	MSG_TYPE_WRITE8 = 12,
 	/** Read byte */
 	MSG_TYPE_READ8 = 13,
+	/**
+	 * Batch of operations. The header packet carries the number of
+	 * operations in value and is followed by that many request packets.
+	 * The response is a MSG_TYPE_BATCH header followed by one response
+	 * packet per operation, in request order. Posted writes in a batch are
+	 * answered there like plain writes and are not counted by MSG_TYPE_FENCE.
+	 * Batches can not be nested and can not contain MSG_TYPE_READ_BLOCK or
+	 * MSG_TYPE_WRITE_BLOCK, which are answered with MSG_TYPE_ERROR.
+	 */
+	MSG_TYPE_BATCH = 14,
+	/** Posted write of a word. No response is sent. */
+	MSG_TYPE_POSTED_WRITE32 = 15,
+	/** Posted write of a short. No response is sent. */
+	MSG_TYPE_POSTED_WRITE16 = 16,
+	/** Posted write of a byte. No response is sent. */
+	MSG_TYPE_POSTED_WRITE8 = 17,
+	/**
+	 * Fence for posted writes. Answered once all preceding posted writes
+	 * have been applied with MSG_TYPE_OK if they all succeeded. Otherwise
+	 * the answer is MSG_TYPE_ERROR with the number of failed writes since
+	 * the previous fence in value and the first failing address in addr.
+	 */
+	MSG_TYPE_FENCE = 18,
+	/**
+	 * Read a block of memory. The length in bytes is in value. The
+	 * response carries the number of payload bytes that follow it in
+	 * value (zero on error).
+	 */
+	MSG_TYPE_READ_BLOCK = 19,
+	/**
+	 * Write a block of memory. The length in bytes is in value and the
+	 * packet is followed by that many bytes of payload.
+	 */
+	MSG_TYPE_WRITE_BLOCK = 20,
+	/**
+	 * Query the regions that the simulator may cache. Registers in these
+	 * regions only change when written over the bus. The index of the
+	 * region is in addr. The response carries the first address of the
+	 * region in addr and its size in value, or MSG_TYPE_ERROR once the
+	 * index is past the last region.
+	 */
+	MSG_TYPE_CACHEABLE = 21,
 };
@@ -0,0 +1,289 @@
+/* SPDX-License-Identifier: Apache-2.0 */
+/*
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ * Consulting: https://swedishembedded.com/consulting
+ * Training: https://swedishembedded.com/tag/training
+ */
+
+#pragma once
+
+/*!
+ * @defgroup instrulink-shm Instrulink Shared Memory Transport
+ * @{
+ *
+ * Layout of the shared memory segment used when the simulator and the
+ * instrument run on the same host. The segment is created and initialized by
+ * the simulator (either with shm_open() or as a memfd inherited by the
+ * instrument process) and holds three single producer single consumer byte
+ * rings. The same packet stream that would go over the sockets is written into
+ * the rings.
+ *
+ * Head and tail are free running byte counters. The consumer only writes the
+ * tail and the producer only writes the head. A side that has to wait sets the
+ * corresponding waiter flag and sleeps on the counter with a futex so that
+ * the other side only makes a wake syscall when somebody is actually sleeping.
+ *
+ * A side that disconnects sets the closed flag and wakes up every sleeper. A
+ * side that crashes can not do that, so sleepers wake up every
+ * INSTRULINK_SHM_POLL_NS and check that the process at the other end of the
+ * ring still exists. Reads and writes fail with -EIO once the peer is gone.
+ **/
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+
+/** Magic value identifying an initialized segment ("ILNK") */
+#define INSTRULINK_SHM_MAGIC 0x494c4e4b
+/** Version of the segment layout */
+#define INSTRULINK_SHM_VERSION 2
+/** Size of each ring in bytes (must be a power of two) */
+#define INSTRULINK_SHM_RING_SIZE 8192
+/** Time a side sleeps on a ring before checking that its peer is still alive */
+#define INSTRULINK_SHM_POLL_NS 50000000
+
+struct instrulink_shm_ring {
+	/** Bytes written by the producer */
+	uint32_t head __attribute__((aligned(64)));
+	/** Set by the consumer before sleeping on head */
+	uint32_t data_waiter;
+	/** Bytes consumed by the consumer */
+	uint32_t tail __attribute__((aligned(64)));
+	/** Set by the producer before sleeping on tail */
+	uint32_t space_waiter;
+	/** Ring storage */
+	uint8_t data[INSTRULINK_SHM_RING_SIZE] __attribute__((aligned(64)));
+};
+
+struct instrulink_shm {
+	/** Set to INSTRULINK_SHM_MAGIC once the segment is initialized */
+	uint32_t magic;
+	/** Set to INSTRULINK_SHM_VERSION */
+	uint32_t version;
+	/** Process id of the simulator (0 if it should not be checked) */
+	int32_t simulator_pid;
+	/** Process id of the instrument, set when it connects (0 if not connected) */
+	int32_t instrument_pid;
+	/** Set by either side when it disconnects */
+	uint32_t closed;
+	/** Requests from simulator to instrument */
+	struct instrulink_shm_ring req;
+	/** Responses from instrument to simulator */
+	struct instrulink_shm_ring res;
+	/** Interrupt notifications from instrument to simulator */
+	struct instrulink_shm_ring irq;
+};
+
+/** Sleep while *addr is value. Returns false if the sleep timed out. */
+static inline bool instrulink_shm_futex_wait(uint32_t *addr, uint32_t value)
+{
+	struct timespec ts = { 0, INSTRULINK_SHM_POLL_NS };
+
+	return syscall(SYS_futex, addr, FUTEX_WAIT, value, &ts, NULL, 0) == 0 || errno != ETIMEDOUT;
+}
+
+static inline void instrulink_shm_futex_wake(uint32_t *addr)
+{
+	syscall(SYS_futex, addr, FUTEX_WAKE, 1, NULL, NULL, 0);
+}
+
+/**
+ * \brief Check that the other side of a ring can still make progress
+ * \param shm mapped segment
+ * \param peer process id of the other side (0 to only check the closed flag)
+ **/
+static inline bool instrulink_shm_peer_alive(struct instrulink_shm *shm, int32_t peer)
+{
+	if (__atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE)) {
+		return false;
+	}
+	return peer == 0 || kill(peer, 0) == 0 || errno != ESRCH;
+}
+
+/**
+ * \brief Initialize a freshly created segment (simulator side)
+ * \param shm mapped segment
+ **/
+static inline void instrulink_shm_init(struct instrulink_shm *shm)
+{
+	memset(shm, 0, sizeof(*shm));
+	shm->version = INSTRULINK_SHM_VERSION;
+	shm->simulator_pid = getpid();
+	__atomic_store_n(&shm->magic, INSTRULINK_SHM_MAGIC, __ATOMIC_RELEASE);
+}
+
+/**
+ * \brief Mark the connection closed and wake up everybody sleeping on a ring (either side)
+ * \param shm mapped segment
+ **/
+static inline void instrulink_shm_close(struct instrulink_shm *shm)
+{
+	struct instrulink_shm_ring *rings[] = { &shm->req, &shm->res, &shm->irq };
+
+	__atomic_store_n(&shm->closed, 1, __ATOMIC_SEQ_CST);
+	for (size_t c = 0; c < sizeof(rings) / sizeof(rings[0]); c++) {
+		instrulink_shm_futex_wake(&rings[c]->head);
+		instrulink_shm_futex_wake(&rings[c]->tail);
+	}
+}
+
+/** Process id of the side producing into a ring (the simulator only produces requests) */
+static inline int32_t instrulink_shm_producer(struct instrulink_shm *shm,
+					      struct instrulink_shm_ring *ring)
+{
+	return ring == &shm->req ? shm->simulator_pid : shm->instrument_pid;
+}
+
+/** Process id of the side consuming from a ring */
+static inline int32_t instrulink_shm_consumer(struct instrulink_shm *shm,
+					      struct instrulink_shm_ring *ring)
+{
+	return ring == &shm->req ? shm->instrument_pid : shm->simulator_pid;
+}
+
+/**
+ * \brief Number of bytes that can be read from the ring without blocking
+ * \param ring ring to check
+ **/
+static inline uint32_t instrulink_shm_ring_used(struct instrulink_shm_ring *ring)
+{
+	return __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE) - ring->tail;
+}
+
+/**
+ * \brief Copy bytes from the front of a ring without consuming them (consumer)
+ * \param ring ring to read from
+ * \param data buffer receiving the data
+ * \param len number of bytes to copy, at most instrulink_shm_ring_used()
+ **/
+static inline void instrulink_shm_ring_peek(struct instrulink_shm_ring *ring, void *data,
+					    size_t len)
+{
+	uint32_t off = ring->tail & (INSTRULINK_SHM_RING_SIZE - 1);
+	size_t n = len < INSTRULINK_SHM_RING_SIZE - off ? len : INSTRULINK_SHM_RING_SIZE - off;
+
+	memcpy(data, &ring->data[off], n);
+	memcpy((uint8_t *)data + n, &ring->data[0], len - n);
+}
+
+/**
+ * \brief Write bytes into a ring, sleeping while the ring is full (producer)
+ * \param shm segment holding the ring
+ * \param ring ring to write to
+ * \param data data to write
+ * \param len number of bytes to write
+ * \returns 0 on success
+ * \retval -EIO the consumer disconnected or died
+ **/
+static inline int instrulink_shm_ring_write(struct instrulink_shm *shm,
+					    struct instrulink_shm_ring *ring, const void *data,
+					    size_t len)
+{
+	const uint8_t *src = (const uint8_t *)data;
+	uint32_t head = ring->head;
+
+	while (len > 0) {
+		uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+		uint32_t space = INSTRULINK_SHM_RING_SIZE - (head - tail);
+
+		if (space == 0) {
+			bool woken = true;
+
+			if (__atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE)) {
+				return -EIO;
+			}
+			__atomic_store_n(&ring->space_waiter, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST) == tail) {
+				woken = instrulink_shm_futex_wait(&ring->tail, tail);
+			}
+			__atomic_store_n(&ring->space_waiter, 0, __ATOMIC_RELAXED);
+			if (!woken &&
+			    !instrulink_shm_peer_alive(shm, instrulink_shm_consumer(shm, ring))) {
+				return -EIO;
+			}
+			continue;
+		}
+
+		uint32_t off = head & (INSTRULINK_SHM_RING_SIZE - 1);
+		uint32_t n = len < space ? len : space;
+
+		if (n > INSTRULINK_SHM_RING_SIZE - off) {
+			n = INSTRULINK_SHM_RING_SIZE - off;
+		}
+		memcpy(&ring->data[off], src, n);
+		src += n;
+		len -= n;
+		head += n;
+		__atomic_store_n(&ring->head, head, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->data_waiter, __ATOMIC_SEQ_CST)) {
+			instrulink_shm_futex_wake(&ring->head);
+		}
+	}
+	return 0;
+}
+
+/**
+ * \brief Read bytes from a ring, sleeping until enough data is available (consumer)
+ * \param shm segment holding the ring
+ * \param ring ring to read from
+ * \param data buffer receiving the data
+ * \param len number of bytes to read
+ * \returns 0 on success
+ * \retval -EIO the producer disconnected or died
+ **/
+static inline int instrulink_shm_ring_read(struct instrulink_shm *shm,
+					   struct instrulink_shm_ring *ring, void *data, size_t len)
+{
+	uint8_t *dst = (uint8_t *)data;
+	uint32_t tail = ring->tail;
+
+	while (len > 0) {
+		uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+		uint32_t used = head - tail;
+
+		if (used == 0) {
+			bool woken = true;
+
+			if (__atomic_load_n(&shm->closed, __ATOMIC_ACQUIRE)) {
+				return -EIO;
+			}
+			__atomic_store_n(&ring->data_waiter, 1, __ATOMIC_SEQ_CST);
+			if (__atomic_load_n(&ring->head, __ATOMIC_SEQ_CST) == head) {
+				woken = instrulink_shm_futex_wait(&ring->head, head);
+			}
+			__atomic_store_n(&ring->data_waiter, 0, __ATOMIC_RELAXED);
+			if (!woken &&
+			    !instrulink_shm_peer_alive(shm, instrulink_shm_producer(shm, ring))) {
+				return -EIO;
+			}
+			continue;
+		}
+
+		uint32_t off = tail & (INSTRULINK_SHM_RING_SIZE - 1);
+		uint32_t n = len < used ? len : used;
+
+		if (n > INSTRULINK_SHM_RING_SIZE - off) {
+			n = INSTRULINK_SHM_RING_SIZE - off;
+		}
+		memcpy(dst, &ring->data[off], n);
+		dst += n;
+		len -= n;
+		tail += n;
+		__atomic_store_n(&ring->tail, tail, __ATOMIC_SEQ_CST);
+		if (__atomic_load_n(&ring->space_waiter, __ATOMIC_SEQ_CST)) {
+			instrulink_shm_futex_wake(&ring->tail);
+		}
+	}
+	return 0;
+}
+
+/*!
+ * @}
+ **/
@@ -0,0 +1,111 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include <errno.h>
+#include <stdint.h>
+
+#include <algorithm>
+#include <vector>
+
+/**
+ * \brief Address decoder for memory mapped targets
+ * \details
+ *		Mappings are kept in a flat vector sorted by base address so that a
+ *		lookup is a binary search over contiguous memory. Accesses outside of
+ *		the span covered by all mappings are rejected before searching.
+ *		Overlapping mappings are rejected when they are added.
+ **/
+template <typename T> class AddressMap {
+    public:
+	struct Mapping {
+		/** First address of the mapping */
+		uint64_t base;
+		/** Size of the mapping in bytes */
+		uint64_t size;
+		/** Target that handles accesses within the mapping */
+		T *target;
+	};
+
+	/**
+	 * \brief Map a target into the address space
+	 * \param base first address of the region
+	 * \param size size of the region in bytes
+	 * \param target target to dispatch accesses to
+	 * \returns 0 on success or negative on error
+	 * \retval -EINVAL invalid region or target
+	 * \retval -EEXIST region overlaps an existing mapping
+	 **/
+	int add(uint64_t base, uint64_t size, T *target)
+	{
+		if (!target || size == 0 || base + size < base) {
+			return -EINVAL;
+		}
+
+		auto it = upper(base);
+
+		if (it != map.end() && it->base < base + size) {
+			return -EEXIST;
+		}
+		if (it != map.begin() && (it - 1)->base + (it - 1)->size > base) {
+			return -EEXIST;
+		}
+
+		map.insert(it, Mapping{ base, size, target });
+
+		start = map.front().base;
+		end = map.back().base + map.back().size;
+		return 0;
+	}
+
+	/**
+	 * \brief Find mapping that fully contains an access
+	 * \param addr address of the access
+	 * \param len length of the access in bytes
+	 * \returns mapping or NULL if the access is not mapped
+	 **/
+	const Mapping *find(uint64_t addr, uint64_t len = 1) const
+	{
+		if (addr < start || addr >= end) {
+			return NULL;
+		}
+
+		auto it = upper(addr);
+
+		if (it == map.begin()) {
+			return NULL;
+		}
+
+		const Mapping *m = &*(it - 1);
+
+		if (addr - m->base + len > m->size) {
+			return NULL;
+		}
+		return m;
+	}
+
+	const std::vector<Mapping> &mappings() const
+	{
+		return map;
+	}
+
+    private:
+	typename std::vector<Mapping>::const_iterator upper(uint64_t addr) const
+	{
+		return std::upper_bound(map.begin(), map.end(), addr,
+					[](uint64_t a, const Mapping &m) { return a < m.base; });
+	}
+
+	/** Mappings sorted by base address */
+	std::vector<Mapping> map;
+	/** Lowest mapped address */
+	uint64_t start = 0;
+	/** One past the highest mapped address */
+	uint64_t end = 0;
+};
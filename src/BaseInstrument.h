@@ -11,55 +11,223 @@
 #pragma once
 
 #include "IInstrument.h"
+#include "EditQueue.h"
+#include "Snapshot.h"
 #include "instruments/keypad.h"
 
 #include <errno.h>
-#include <imgui.h>
+#include <stdio.h>
+
+#include <type_traits>
+
+/** Attributes of the registers of a BaseInstrument (plain read/write registers have none) */
+enum RegisterAttribute {
+	/** Writes are ignored */
+	REG_RO = 1 << 0,
+	/** Reading clears the register */
+	REG_RC = 1 << 1,
+	/** Writing a one clears the corresponding bit */
+	REG_W1C = 1 << 2,
+	/** Accesses trigger an action of the instrument (handled by D) */
+	REG_ACTION = 1 << 3,
+	/** Changed by the instrument itself or from the GUI */
+	REG_VOLATILE = 1 << 4,
+	/** Reading has no side effects (neither in regs nor in a read<W>() of D) */
+	REG_PURE = 1 << 5,
+};
+
+/**
+ * \brief Instrument backed by a register file of type T
+ * \details
+ *		Register accesses go through access() which switches on the width
+ *		and calls read<W>() and write<W>() of D without any further virtual
+ *		calls. An instrument with registers that have side effects passes
+ *		itself as D and shadows read<W>() and write<W>() (calling the ones
+ *		of BaseInstrument for plain registers). Without D every access goes
+ *		straight to the register file. Widths not in D::WIDTHS are rejected
+ *		with -ENOTSUP. The per-width accessors are final wrappers of
+ *		access() so that an instrument can not override one of them and
+ *		have it bypassed by the container.
+ *
+ *		Each register can be given RegisterAttribute flags with
+ *		defineRegister(). Read-clear, write-one-to-clear and read-only
+ *		registers are handled by the plain read<W>() and write<W>().
+ *		Reads are only answered from the snapshot for registers declared
+ *		REG_PURE, and only REG_PURE registers without any flag other than
+ *		REG_RO are reported as cacheable. Registers that were not declared
+ *		always go through access() with the lock held.
+ **/
+template <typename T, typename D = void> class BaseInstrument : public IInstrument {
+    protected:
+	/** Class whose read<W>() and write<W>() handle accesses */
+	typedef typename std::conditional<std::is_void<D>::value, BaseInstrument, D>::type Self;
 
-template <typename T> class BaseInstrument : public IInstrument {
     public:
+	/** Access widths in bytes (as a mask of 1, 2 and 4) served by the instrument */
+	static const unsigned WIDTHS = sizeof(uint32_t);
+
+	BaseInstrument()
+	{
+		memset(&view, 0, sizeof(view));
+		memset(attributes, 0, sizeof(attributes));
+	}
 	virtual ~BaseInstrument()
 	{
 	}
-	virtual int write32(uint64_t addr, uint64_t data)
+	virtual int access(uint64_t addr, unsigned width, bool write, uint64_t *data) override
 	{
+		if (!(width & Self::WIDTHS)) {
+			return -ENOTSUP;
+		}
+		switch (width) {
+		case sizeof(uint8_t):
+			return transfer<uint8_t>(addr, write, data);
+		case sizeof(uint16_t):
+			return transfer<uint16_t>(addr, write, data);
+		case sizeof(uint32_t):
+			return transfer<uint32_t>(addr, write, data);
+		}
 		return -ENOTSUP;
 	}
-	virtual int write16(uint64_t addr, uint64_t data)
+	virtual int peek(uint64_t addr, unsigned width, uint64_t *data) override
 	{
-		return -ENOTSUP;
+		uint64_t value = 0;
+
+		if (width != sizeof(uint8_t) && width != sizeof(uint16_t) && width != sizeof(uint32_t)) {
+			return -EAGAIN;
+		}
+		if (!(width & Self::WIDTHS) || addr > sizeof(T) || width > sizeof(T) - addr) {
+			return -EAGAIN;
+		}
+		for (unsigned c = 0; c < width; c++) {
+			unsigned attr = this->attributes[addr + c];
+
+			if (!(attr & REG_PURE) || (attr & (REG_RC | REG_ACTION))) {
+				return -EAGAIN;
+			}
+		}
+		snapshot.read(addr, &value, width);
+		*data = value;
+		return 0;
 	}
-	virtual int write8(uint64_t addr, uint64_t data)
+	virtual std::vector<Region> cacheable() override
 	{
-		return -ENOTSUP;
+		std::vector<Region> regions;
+
+		for (size_t c = 0; c < sizeof(T); c++) {
+			unsigned attr = this->attributes[c];
+
+			if (!(attr & REG_PURE) || (attr & ~(REG_PURE | REG_RO))) {
+				continue;
+			}
+			if (!regions.empty() && regions.back().base + regions.back().size == c) {
+				regions.back().size++;
+			} else {
+				regions.push_back(Region{ c, 1 });
+			}
+		}
+		return regions;
 	}
-	virtual int read32(uint64_t addr, uint64_t *data)
+	virtual int write32(uint64_t addr, uint64_t data) override final
 	{
-		return -ENOTSUP;
+		return access(addr, sizeof(uint32_t), true, &data);
 	}
-	virtual int read16(uint64_t addr, uint64_t *data)
+	virtual int write16(uint64_t addr, uint64_t data) override final
 	{
-		return -ENOTSUP;
+		return access(addr, sizeof(uint16_t), true, &data);
 	}
-	virtual int read8(uint64_t addr, uint64_t *data)
+	virtual int write8(uint64_t addr, uint64_t data) override final
 	{
-		return -ENOTSUP;
+		return access(addr, sizeof(uint8_t), true, &data);
+	}
+	virtual int read32(uint64_t addr, uint64_t *data) override final
+	{
+		return access(addr, sizeof(uint32_t), false, data);
+	}
+	virtual int read16(uint64_t addr, uint64_t *data) override final
+	{
+		return access(addr, sizeof(uint16_t), false, data);
+	}
+	virtual int read8(uint64_t addr, uint64_t *data) override final
+	{
+		return access(addr, sizeof(uint8_t), false, data);
+	}
+	/**
+	 * Block accesses copy straight to and from the register file unless
+	 * they cover registers with side effects, which are accessed word by
+	 * word through access() like single accesses.
+	 **/
+	virtual int writeBlock(uint64_t addr, const uint8_t *data, size_t len) override
+	{
+		if (addr > sizeof(regs) || len > sizeof(regs) - addr) {
+			return -EIO;
+		}
+		if (!plain(addr, len)) {
+			return IInstrument::writeBlock(addr, data, len);
+		}
+		memcpy((uint8_t *)&regs + addr, data, len);
+		return 0;
+	}
+	virtual int readBlock(uint64_t addr, uint8_t *data, size_t len) override
+	{
+		if (addr > sizeof(regs) || len > sizeof(regs) - addr) {
+			return -EIO;
+		}
+		if (!plain(addr, len)) {
+			return IInstrument::readBlock(addr, data, len);
+		}
+		memcpy(data, (uint8_t *)&regs + addr, len);
+		return 0;
 	}
 	virtual void tick() override{};
 	virtual void onIRQ(std::function<void()> cb)
 	{
 		notifyIRQ = cb;
 	}
+	virtual void commit() override
+	{
+		edits.apply();
+		snapshot.publish(regs);
+	}
+	virtual void refresh() override
+	{
+		snapshot.read(&view);
+	}
+	/** Dump the published register file as 32 bit words */
+	virtual void telemetry(FILE *out) override
+	{
+		uint32_t words[(sizeof(T) + 3) / 4] = { 0 };
+		T copy;
+
+		snapshot.read(&copy);
+		memcpy(words, &copy, sizeof(copy));
+		for (size_t c = 0; c < sizeof(words) / sizeof(words[0]); c++) {
+			fprintf(out, c ? " %08x" : "%08x", words[c]);
+		}
+		fprintf(out, "\n");
+	}
 
     protected:
+	/** Plain register write (shadowed by D for registers with side effects) */
 	template <typename W> int write(uint64_t addr, uint64_t data)
 	{
 		if ((addr + sizeof(W)) > sizeof(regs)) {
 			return -EIO;
 		}
-		*((W *)((uint8_t *)&regs + addr)) = (W)data;
+
+		W *reg = (W *)((uint8_t *)&regs + addr);
+		W value = data;
+
+		if (attributesOf<W>(addr) & (REG_RO | REG_W1C)) {
+			W ro = lanes<W>(addr, REG_RO);
+			W w1c = lanes<W>(addr, REG_W1C);
+
+			value = (*reg & ro) | (*reg & w1c & ~value) | (value & ~(ro | w1c));
+		}
+		*reg = value;
 		return 0;
 	}
+	/** Plain register read (shadowed by D for registers with side effects) */
 	template <typename W> int read(uint64_t addr, uint64_t *data)
 	{
 		if ((addr + sizeof(W)) > sizeof(regs)) {
@@ -67,9 +235,115 @@ template <typename T> class BaseInstrument : public IInstrument {
 			*data = ~0;
 			return -EIO;
 		}
-		*data = *((W *)((uint8_t *)&regs + addr));
+
+		W *reg = (W *)((uint8_t *)&regs + addr);
+
+		*data = *reg;
+		if (attributesOf<W>(addr) & REG_RC) {
+			*reg &= ~lanes<W>(addr, REG_RC);
+		}
 		return 0;
 	}
+	/**
+	 * \brief Set the attributes of a register
+	 * \param field register within regs
+	 * \param attr RegisterAttribute flags
+	 **/
+	template <typename V> void defineRegister(const V *field, unsigned attr)
+	{
+		size_t offset = (const uint8_t *)field - (const uint8_t *)&regs;
+
+		memset(&this->attributes[offset], attr, sizeof(V));
+	}
+	/** Queue an edit made by render() to be applied with the container lock held */
+	void edit(std::function<void()> fn)
+	{
+		edits.push(std::move(fn));
+	}
+	/**
+	 * \brief Queue a write of a field of view back into the register file
+	 * \details Registers declared REG_PURE must also be REG_VOLATILE, the
+	 * simulator may otherwise cache them and never see the edit. Edits of
+	 * such registers are dropped with an error.
+	 **/
+	template <typename V> void editRegister(const V *field)
+	{
+		size_t offset = (const uint8_t *)field - (const uint8_t *)&view;
+		V value = *field;
+
+		if (!editable(offset, sizeof(V))) {
+			fprintf(stderr,
+				"Error: register at offset %zu is edited from the GUI but not "
+				"declared REG_VOLATILE\n",
+				offset);
+			return;
+		}
+		edit([this, offset, value] { memcpy((uint8_t *)&regs + offset, &value, sizeof(V)); });
+	}
+	/** Register file (accessed with the container lock held) */
 	T regs;
+	/** Copy of the register file used by render() */
+	T view;
 	std::function<void()> notifyIRQ;
+
+    private:
+	/** True if a block can be copied without going through D or any attribute */
+	bool plain(uint64_t addr, size_t len) const
+	{
+		if (!std::is_void<D>::value) {
+			return false;
+		}
+		for (size_t c = addr; c < addr + len; c++) {
+			if (this->attributes[c] & (REG_RO | REG_RC | REG_W1C | REG_ACTION)) {
+				return false;
+			}
+		}
+		return true;
+	}
+	/** True if no byte of a register is pure without being volatile */
+	bool editable(size_t offset, size_t size) const
+	{
+		for (size_t c = offset; c < offset + size; c++) {
+			if ((this->attributes[c] & (REG_PURE | REG_VOLATILE)) == REG_PURE) {
+				return false;
+			}
+		}
+		return true;
+	}
+	/** Attributes of all bytes of an access */
+	template <typename W> unsigned attributesOf(uint64_t addr) const
+	{
+		unsigned attr = 0;
+
+		for (size_t c = 0; c < sizeof(W); c++) {
+			attr |= this->attributes[addr + c];
+		}
+		return attr;
+	}
+	/** Mask of the bytes of an access that have an attribute */
+	template <typename W> W lanes(uint64_t addr, unsigned attr) const
+	{
+		W mask = 0;
+
+		for (size_t c = 0; c < sizeof(W); c++) {
+			if (this->attributes[addr + c] & attr) {
+				mask |= (W)(0xffu << (8 * c));
+			}
+		}
+		return mask;
+	}
+	template <typename W> int transfer(uint64_t addr, bool write, uint64_t *data)
+	{
+		Self *self = static_cast<Self *>(this);
+
+		return write ? self->template write<W>(addr, *data) :
+			       self->template read<W>(addr, data);
+	}
+
+	/** Last published register file */
+	Snapshot<T> snapshot;
+	/** Edits queued by render() */
+	EditQueue edits;
+	/** RegisterAttribute flags of every byte of the register file */
+	uint8_t attributes[sizeof(T)];
 };
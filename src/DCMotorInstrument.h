@@ -8,30 +8,50 @@
  * This is a memory view instrument for debugging memory access.
  **/
 
+#pragma once
+
 extern "C" {
 #include <control/model/dc_motor.h>
 }
 
 #include "instruments/dcmotor.h"
 #include "BaseInstrument.h"
-#include "ScrollingBuffer.h"
+#include "TimingWheel.h"
+
+/** Simulated time between two steps of the motor model in nanoseconds */
+#define DCMOTOR_STEP_NS 1000000ULL
 
-class DCMotorInstrument : public BaseInstrument<struct dcmotor_instrument> {
+class DCMotorInstrument : public BaseInstrument<struct dcmotor_instrument, DCMotorInstrument> {
     public:
 	DCMotorInstrument();
-	void render() override;
-	int read32(uint64_t addr, uint64_t *value) override;
-	int write32(uint64_t addr, uint64_t value) override;
+	void advance(uint64_t ns) override;
+	/** Steps the model from a periodic event instead of counting time in advance() */
+	void setScheduler(TimingWheel *wheel) override;
+	void commit() override;
+	void refresh() override;
+
+    protected:
+	friend BaseInstrument;
+
+	template <typename W> int write(uint64_t addr, uint64_t data)
+	{
+		if (addr == __builtin_offsetof(struct dcmotor_instrument, tick)) {
+			step();
+			return 0;
+		}
+		return BaseInstrument::write<W>(addr, data);
+	}
+	/** Run one step of the motor model with the current control signal */
+	void step();
 
-    private:
 	struct model_dc_motor dc_motor;
+	/** Last published state of the motor model */
+	Snapshot<struct model_dc_motor> model;
+	/** Copy of the motor model used by render() */
+	struct model_dc_motor motor;
+	/** Simulated time not yet consumed by a model step (no scheduler) */
+	uint64_t pending_ns;
+	/** Periodic model step when a scheduler is available */
+	TimingEvent step_event;
 	struct dcmotor_instrument data;
-	struct {
-		float t;
-		ScrollingBuffer omega;
-		ScrollingBuffer current;
-		ScrollingBuffer reference;
-		ScrollingBuffer control;
-		ScrollingBuffer error;
-	} plot;
 };
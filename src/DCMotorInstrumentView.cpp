@@ -0,0 +1,167 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include "DCMotorInstrumentView.h"
+
+#include <cstdio>
+#include <array>
+#include <implot.h>
+#include <math.h>
+
+void implot_radial_line(const char *name, float inner_radius, float outer_radius, float angle)
+{
+	const float cos_angle = cosf(angle);
+	const float sin_angle = sinf(angle);
+	std::array<float, 2> xs = { inner_radius * cos_angle, outer_radius * cos_angle };
+	std::array<float, 2> ys = { inner_radius * sin_angle, outer_radius * sin_angle };
+	ImPlot::PlotLine(name, xs.data(), ys.data(), 2);
+}
+
+DCMotorInstrumentView::DCMotorInstrumentView()
+{
+	this->controller = 0;
+	this->plot.t = 0;
+	this->plot.omega.AddPoint(0, 0);
+	this->plot.current.AddPoint(0, 0);
+	this->plot.reference.AddPoint(0, 0);
+	this->plot.control.AddPoint(0, 0);
+	this->plot.error.AddPoint(0, 0);
+}
+
+void DCMotorInstrumentView::modelSlider(const char *label, float *field, float min, float max)
+{
+	if (!ImGui::SliderFloat(label, field, min, max)) {
+		return;
+	}
+
+	size_t offset = (const uint8_t *)field - (const uint8_t *)&this->motor;
+	float value = *field;
+
+	edit([this, offset, value] {
+		memcpy((uint8_t *)&this->dc_motor + offset, &value, sizeof(value));
+	});
+}
+
+void DCMotorInstrumentView::registerSlider(const char *label, float *field, float min, float max)
+{
+	if (ImGui::SliderFloat(label, field, min, max)) {
+		editRegister(field);
+	}
+}
+
+void DCMotorInstrumentView::render()
+{
+	ImGui::BeginGroup();
+
+	ImGui::Columns(2);
+	ImGui::SetColumnWidth(0, 220);
+
+	if (ImPlot::BeginPlot("##Rotor Angle", ImVec2(200, 200))) {
+		ImPlot::SetupAxisLimits(ImAxis_X1, -1.0, 1.0);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, -1.0, 1.0);
+		ImPlot::SetupAxis(ImAxis_X1, nullptr, ImPlotAxisFlags_NoTickLabels);
+		ImPlot::SetupAxis(ImAxis_Y1, nullptr, ImPlotAxisFlags_NoTickLabels);
+		ImPlot::PushStyleColor(ImPlotCol_Line, (uint32_t)ImColor(1.0f, 1.0f, 1.0f, 1.0));
+		implot_radial_line("##Rotor Angle", 0.0f, 1.0f, this->motor.position);
+		ImPlot::PushStyleColor(ImPlotCol_Line, (uint32_t)ImColor(1.0f, 1.0f, 1.0f, 0.2));
+		ImPlot::PopStyleColor(2);
+		ImPlot::EndPlot();
+	}
+
+	ImGui::NextColumn();
+
+	if (ImGui::CollapsingHeader("DC Motor simulation", ImGuiTreeNodeFlags_DefaultOpen)) {
+		modelSlider("Drive voltage (V)", &this->motor.u[0], -25.0f, 25.0f);
+		modelSlider("Angular velocity (Rad/sec)", &this->motor.x[0], -2.5f, 2.5f);
+		modelSlider("Armature current (Amp)", &this->motor.x[1], -25.f, 25.f);
+		modelSlider("Rotor position (Rad)", &this->motor.position, -M_PI, M_PI);
+		modelSlider("Rotor inertia (J) (kg.m^2)", &this->motor.J, 0.0f, 0.25f);
+		modelSlider("Motor viscous friction constant (b) (N.m.s)", &this->motor.b, 0.0f,
+			    0.2f);
+		modelSlider("Electromotiva force (Ke) (V/rad/sec)", &this->motor.K, 0.0f, 2.5f);
+		modelSlider("Torque constant (Ki) (N.m/Amp)", &this->motor.K, 0.0f, 0.5f);
+		modelSlider("Electrical resistance (R) (Ohm)", &this->motor.R, 0.0f, 15.f);
+		modelSlider("Electrical inductance (L) (Henry)", &this->motor.L, 0.0f, 5.0f);
+	}
+
+	if (ImGui::CollapsingHeader("Controller", ImGuiTreeNodeFlags_DefaultOpen)) {
+		const char *controllers[] = { "PID Controller", "LQI Controller" };
+
+		if (ImGui::BeginCombo("##combo", controllers[this->controller])) {
+			for (int n = 0; n < IM_ARRAYSIZE(controllers); n++) {
+				bool is_selected = (this->controller == (uint32_t)n);
+				if (ImGui::Selectable(controllers[n], is_selected))
+					this->controller = n;
+				if (is_selected)
+					ImGui::SetItemDefaultFocus();
+			}
+			ImGui::EndCombo();
+		}
+
+		uint32_t selected = this->controller;
+
+		if (this->view.controller != selected) {
+			this->view.controller = selected;
+			editRegister(&this->view.controller);
+		}
+		if (selected == 0) {
+			registerSlider("Proportional gain (Kp)", &this->view.pid.Kp, 0.f, 10.f);
+			registerSlider("Integral gain (Ki)", &this->view.pid.Ki, 0.f, 1.f);
+			registerSlider("Derivative gain (Kd)", &this->view.pid.Kd, 0.f, 100.0f);
+			registerSlider("Derivative filter pole (d)", &this->view.pid.d, 0.f, 1.f);
+		} else {
+			registerSlider("Angular velocity error gain (L[0])", &this->view.lqi.L[0], 0.f,
+				   5.f);
+			registerSlider("Current gain (L[1])", &this->view.lqi.L[1], 0.f, 5.f);
+			registerSlider("Setpoing integral gain (Li)", &this->view.lqi.Li, 0.f, 1.0f);
+		}
+		registerSlider("Feedforward gain (Kff)", &this->view.Kff, 0.f, 10.f);
+		registerSlider("Control action voltage (u)", &this->view.control, -25.f, 25.f);
+		registerSlider("Reference angular velocity (r)", &this->view.reference, -2.4f, 2.4f);
+	}
+
+	ImGui::Columns(1);
+
+	if (ImPlot::BeginPlot("Motor output")) {
+		ImPlot::SetupAxisLimits(ImAxis_X1, this->plot.t - 2000.0, this->plot.t,
+					ImGuiCond_Always);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, -5, 5);
+		ImPlot::PlotLine("Omega (w)", &this->plot.omega.Data[0].x,
+				 &this->plot.omega.Data[0].y, this->plot.omega.Data.size(), 0,
+				 this->plot.omega.Offset, 2 * sizeof(float));
+		ImPlot::PlotLine("Current (I)", &this->plot.current.Data[0].x,
+				 &this->plot.current.Data[0].y, this->plot.current.Data.size(), 0,
+				 this->plot.current.Offset, 2 * sizeof(float));
+		ImPlot::PlotLine("Reference (w)", &this->plot.reference.Data[0].x,
+				 &this->plot.reference.Data[0].y, this->plot.reference.Data.size(),
+				 0, this->plot.reference.Offset, 2 * sizeof(float));
+		ImPlot::PlotLine("Control action (u)", &this->plot.control.Data[0].x,
+				 &this->plot.control.Data[0].y, this->plot.control.Data.size(), 0,
+				 this->plot.control.Offset, 2 * sizeof(float));
+		ImPlot::EndPlot();
+	}
+	if (ImPlot::BeginPlot("Controller error")) {
+		ImPlot::SetupAxisLimits(ImAxis_X1, this->plot.t - 2000.0, this->plot.t,
+					ImGuiCond_Always);
+		ImPlot::SetupAxisLimits(ImAxis_Y1, -5, 5);
+		ImPlot::PlotLine("Control error (e)", &this->plot.error.Data[0].x,
+				 &this->plot.error.Data[0].y, this->plot.error.Data.size(), 0,
+				 this->plot.error.Offset, 2 * sizeof(float));
+		ImPlot::EndPlot();
+	}
+
+	float t = this->plot.t++;
+
+	this->plot.omega.AddPoint(t, this->view.omega);
+	this->plot.current.AddPoint(t, this->motor.x[1]);
+	this->plot.reference.AddPoint(t, this->view.reference);
+	this->plot.control.AddPoint(t, this->view.control);
+	this->plot.error.AddPoint(t, this->view.reference - this->view.omega);
+
+	ImGui::EndGroup();
+}
@@ -0,0 +1,40 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include "DCMotorInstrument.h"
+
+#include <imgui.h>
+
+#include "ScrollingBuffer.h"
+
+/** ImGui view of the DC motor instrument */
+class DCMotorInstrumentView : public DCMotorInstrument {
+    public:
+	DCMotorInstrumentView();
+	void render() override;
+
+    private:
+	/** Slider that queues a write of a field of motor back into the model */
+	void modelSlider(const char *label, float *field, float min, float max);
+	/** Slider that queues a write of a field of view back into the register file */
+	void registerSlider(const char *label, float *field, float min, float max);
+
+	/** Controller picked in the combo box (view.controller lags until committed) */
+	uint32_t controller;
+
+	struct {
+		float t;
+		ScrollingBuffer omega;
+		ScrollingBuffer current;
+		ScrollingBuffer reference;
+		ScrollingBuffer control;
+		ScrollingBuffer error;
+	} plot;
+};
@@ -0,0 +1,79 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include <functional>
+
+/**
+ * \brief Lock-free queue of deferred edits
+ * \details
+ *		Any thread can push an edit without taking a lock. The consumer takes
+ *		the whole list with a single exchange and runs the edits in the order
+ *		in which they were pushed.
+ **/
+class EditQueue {
+    public:
+	~EditQueue()
+	{
+		Edit *e = __atomic_exchange_n(&this->head, nullptr, __ATOMIC_ACQUIRE);
+
+		while (e) {
+			Edit *next = e->next;
+			delete e;
+			e = next;
+		}
+	}
+
+	/** Queue an edit (any thread) */
+	void push(std::function<void()> fn)
+	{
+		Edit *e = new Edit{ __atomic_load_n(&this->head, __ATOMIC_RELAXED), std::move(fn) };
+
+		while (!__atomic_compare_exchange_n(&this->head, &e->next, e, true, __ATOMIC_RELEASE,
+						    __ATOMIC_RELAXED)) {
+		}
+	}
+
+	bool empty() const
+	{
+		return __atomic_load_n(&this->head, __ATOMIC_RELAXED) == nullptr;
+	}
+
+	/** Run all queued edits (consumer) */
+	void apply()
+	{
+		if (empty()) {
+			return;
+		}
+
+		Edit *e = __atomic_exchange_n(&this->head, nullptr, __ATOMIC_ACQUIRE);
+		Edit *list = nullptr;
+
+		// the list is newest first
+		while (e) {
+			Edit *next = e->next;
+			e->next = list;
+			list = e;
+			e = next;
+		}
+		while (list) {
+			Edit *next = list->next;
+			list->fn();
+			delete list;
+			list = next;
+		}
+	}
+
+    private:
+	struct Edit {
+		Edit *next;
+		std::function<void()> fn;
+	};
+	Edit *head = nullptr;
+};
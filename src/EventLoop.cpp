@@ -0,0 +1,189 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <stdio.h>
+#include <errno.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/timerfd.h>
+
+#include "EventLoop.h"
+#include "Clock.h"
+
+/** Maximum number of events handled per epoll_wait() */
+#define EVENT_LOOP_EVENTS 16
+
+EventLoop::EventLoop()
+{
+	this->busy_poll = 0;
+	this->stats.polled = 0;
+	this->stats.blocked = 0;
+	this->epoll = epoll_create1(EPOLL_CLOEXEC);
+	this->event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	add(this->event, EPOLLIN, [this](uint32_t events) {
+		uint64_t count;
+
+		if (read(this->event, &count, sizeof(count)) < 0 && errno != EAGAIN) {
+			fprintf(stderr, "Error: could not read event loop wakeup\n");
+		}
+	});
+}
+
+EventLoop::~EventLoop()
+{
+	for (auto &h : this->handlers) {
+		if (h.first != this->event) {
+			// descriptors added with add() belong to the caller
+			epoll_ctl(this->epoll, EPOLL_CTL_DEL, h.first, NULL);
+		}
+	}
+	close(this->event);
+	close(this->epoll);
+}
+
+bool EventLoop::valid() const
+{
+	return this->epoll >= 0 && this->event >= 0;
+}
+
+int EventLoop::add(int fd, uint32_t events, Handler handler)
+{
+	struct epoll_event ev = { .events = events, .data = { .fd = fd } };
+
+	if (epoll_ctl(this->epoll, EPOLL_CTL_ADD, fd, &ev) != 0) {
+		return -errno;
+	}
+	this->handlers[fd].reset(new Handler(std::move(handler)));
+	return 0;
+}
+
+void EventLoop::remove(int fd)
+{
+	auto it = this->handlers.find(fd);
+
+	if (it == this->handlers.end()) {
+		return;
+	}
+	epoll_ctl(this->epoll, EPOLL_CTL_DEL, fd, NULL);
+	// the handler may be the one that is running right now
+	this->removed.push_back(std::move(it->second));
+	this->handlers.erase(it);
+}
+
+int EventLoop::addTimer(std::function<void()> cb)
+{
+	int fd = timerfd_create(CLOCK_MONOTONIC, TFD_CLOEXEC | TFD_NONBLOCK);
+
+	if (fd < 0) {
+		return -errno;
+	}
+
+	int r = add(fd, EPOLLIN, [fd, cb](uint32_t events) {
+		uint64_t expirations;
+
+		if (read(fd, &expirations, sizeof(expirations)) == sizeof(expirations)) {
+			cb();
+		}
+	});
+
+	if (r != 0) {
+		close(fd);
+		return r;
+	}
+	return fd;
+}
+
+int EventLoop::setTimer(int id, uint64_t delay_ns, uint64_t period_ns)
+{
+	struct itimerspec spec = {
+		.it_interval = { .tv_sec = (time_t)(period_ns / 1000000000ULL),
+				 .tv_nsec = (long)(period_ns % 1000000000ULL) },
+		.it_value = { .tv_sec = (time_t)(delay_ns / 1000000000ULL),
+			      .tv_nsec = (long)(delay_ns % 1000000000ULL) },
+	};
+
+	if (timerfd_settime(id, 0, &spec, NULL) != 0) {
+		return -errno;
+	}
+	return 0;
+}
+
+void EventLoop::removeTimer(int id)
+{
+	remove(id);
+	close(id);
+}
+
+void EventLoop::setBusyPoll(uint64_t ns)
+{
+	this->busy_poll = ns;
+}
+
+EventLoop::WaitStats EventLoop::waitStats() const
+{
+	return this->stats;
+}
+
+void EventLoop::post(std::function<void()> fn)
+{
+	this->posted.push(std::move(fn));
+	wakeup();
+}
+
+void EventLoop::wakeup()
+{
+	uint64_t one = 1;
+
+	// never blocks: the counter would have to reach 2^64 - 1 first
+	if (write(this->event, &one, sizeof(one)) != sizeof(one)) {
+		fprintf(stderr, "Error: could not wake up event loop\n");
+	}
+}
+
+int EventLoop::poll(int timeout_ms)
+{
+	struct epoll_event events[EVENT_LOOP_EVENTS];
+	int n = 0;
+
+	if (this->busy_poll && timeout_ms < 0) {
+		uint64_t deadline = monotonic_ns() + this->busy_poll;
+
+		do {
+			n = epoll_wait(this->epoll, events, EVENT_LOOP_EVENTS, 0);
+		} while (n == 0 && monotonic_ns() < deadline);
+		if (n > 0) {
+			this->stats.polled++;
+		}
+	}
+	if (n == 0) {
+		n = epoll_wait(this->epoll, events, EVENT_LOOP_EVENTS, timeout_ms);
+		if (timeout_ms < 0) {
+			this->stats.blocked++;
+		}
+	}
+
+	if (n < 0) {
+		return errno == EINTR ? 0 : -errno;
+	}
+
+	for (int i = 0; i < n; i++) {
+		auto it = this->handlers.find(events[i].data.fd);
+
+		// removed by an earlier handler of this batch
+		if (it != this->handlers.end()) {
+			(*it->second)(events[i].events);
+		}
+	}
+
+	this->posted.apply();
+	this->removed.clear();
+	return n;
+}
@@ -0,0 +1,102 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include "EditQueue.h"
+
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * \brief epoll based event loop
+ * \details
+ *		Descriptors, timers (timerfd) and cross thread wakeups (eventfd) are
+ *		all waited on with a single epoll_wait(). Handlers run on the thread
+ *		that calls poll(). Descriptors and timers must only be added and
+ *		removed from that thread or before it starts polling. post() and
+ *		wakeup() are safe to call from any thread.
+ **/
+class EventLoop {
+    public:
+	/** Called with the epoll events that are ready on the descriptor */
+	typedef std::function<void(uint32_t events)> Handler;
+
+	EventLoop();
+	~EventLoop();
+	/**
+	 * \brief Watch a descriptor
+	 * \param fd descriptor to watch
+	 * \param events epoll events to wait for
+	 * \param handler called when any of the events is ready
+	 * \returns 0 on success or negative on error
+	 **/
+	int add(int fd, uint32_t events, Handler handler);
+	/** Stop watching a descriptor. May be called from within a handler. */
+	void remove(int fd);
+	/**
+	 * \brief Create a timer
+	 * \details The timer is disarmed until setTimer() is called. Expirations
+	 * that were missed while the loop was busy are merged into one call.
+	 * \param cb called on the loop thread when the timer expires
+	 * \returns timer id or negative on error
+	 **/
+	int addTimer(std::function<void()> cb);
+	/**
+	 * \brief Arm or disarm a timer
+	 * \param id timer returned by addTimer()
+	 * \param delay_ns time until the first expiration (0 disarms the timer)
+	 * \param period_ns time between following expirations (0 for a one shot timer)
+	 **/
+	int setTimer(int id, uint64_t delay_ns, uint64_t period_ns = 0);
+	void removeTimer(int id);
+	/** Run fn on the loop thread during the next poll() (any thread) */
+	void post(std::function<void()> fn);
+	/** Make a blocked poll() return (any thread) */
+	void wakeup();
+	/**
+	 * \brief Wait for events and run their handlers
+	 * \param timeout_ms maximum time to wait (-1 waits until an event is ready)
+	 * \returns number of events handled or negative on error
+	 **/
+	int poll(int timeout_ms = -1);
+	bool valid() const;
+	/**
+	 * \brief Spin before blocking
+	 * \details poll() without a timeout checks for events without blocking
+	 * for up to ns nanoseconds before it sleeps in the kernel.
+	 * \param ns time to spin (0 always blocks)
+	 **/
+	void setBusyPoll(uint64_t ns);
+	/** How waits in poll() were satisfied */
+	struct WaitStats {
+		/** Events arrived while spinning */
+		uint64_t polled;
+		/** Had to block in the kernel */
+		uint64_t blocked;
+	};
+	WaitStats waitStats() const;
+
+    private:
+	int epoll;
+	/** eventfd used by wakeup() */
+	int event;
+	/** Handlers by descriptor */
+	std::unordered_map<int, std::unique_ptr<Handler> > handlers;
+	/** Handlers removed while dispatching, destroyed after the batch */
+	std::vector<std::unique_ptr<Handler> > removed;
+	/** Work posted from other threads */
+	EditQueue posted;
+	/** Time to spin before blocking in nanoseconds */
+	uint64_t busy_poll;
+	WaitStats stats;
+};
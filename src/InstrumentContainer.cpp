@@ -14,24 +14,43 @@
 #include <netdb.h>
 #include <unistd.h>
 #include <sys/socket.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <arpa/inet.h>
 #include <pthread.h>
+#include <time.h>
+#include <algorithm>
 #include <array>
 
 #include <instruments/protocol/instrulink.h>
 #include "InstrumentContainer.h"
-
-#include <imgui.h>
-#include <imgui_impl_sdl.h>
-#include <imgui_impl_opengl3.h>
-#include <implot.h>
-
-#include <stdio.h>
-#include <SDL.h>
-#include <SDL_opengl.h>
+#include "Clock.h"
+#include "InstrumentHost.h"
+#include "RealTime.h"
 
 InstrumentContainer::InstrumentContainer()
 {
+	this->posted.errors = 0;
+	this->posted.addr = 0;
+	this->time = 0;
+	this->touched.all = false;
+	this->irq.pending = 0;
+	this->irq.deferred = false;
+	this->irq.window = 0;
+	this->irq.last = 0;
+	this->irq.event = -1;
+	this->irq.timer = -1;
+	this->irq.armed = false;
+	this->loop = NULL;
+	this->attached = false;
+	this->commit_posted = false;
+	this->events.running = false;
+	this->options.headless = false;
+	this->options.telemetry = 0;
+	this->options.rt_cpu = -1;
+	this->options.rt_priority = 0;
+	this->options.busy_poll = 0;
+	memset(&this->stats, 0, sizeof(this->stats));
 	pthread_mutex_init(&this->lock, NULL);
 	this->instrulink = instrulink_new();
 }
@@ -48,181 +67,909 @@ void *_communication_thread(void *data)
 	return NULL;
 }
 
-void InstrumentContainer::emitIRQ()
+void InstrumentContainer::emitIRQ(uint64_t lines)
 {
-	instrulink_irq_notify(this->instrulink);
+	instrulink_irq_notify(this->instrulink, lines);
 }
 
-int InstrumentContainer::addInstrument(IInstrument *i)
+void *_event_thread(void *data)
 {
-	i->onIRQ(std::bind(&InstrumentContainer::emitIRQ, this));
-	this->instruments.push_back(i);
-	return 0;
+	InstrumentContainer *self = (InstrumentContainer *)data;
+
+	while (__atomic_load_n(&self->events.running, __ATOMIC_SEQ_CST)) {
+		if (self->events.loop->poll() < 0) {
+			fprintf(stderr, "Error: event loop failed\n");
+			break;
+		}
+	}
+	return NULL;
 }
 
-int InstrumentContainer::write32(uint64_t addr, uint64_t value)
+void InstrumentContainer::raiseIRQ(unsigned line)
 {
-	int ret = -EIO;
-	for (auto i : instruments) {
-		if (i->write32(addr, value) == 0) {
-			ret = 0;
-		}
+	uint64_t pending = __atomic_fetch_or(&this->irq.pending, 1ULL << line, __ATOMIC_SEQ_CST);
+
+	// lines already pending are on their way or held back by a transaction
+	if (pending == 0 && !__atomic_load_n(&this->irq.deferred, __ATOMIC_SEQ_CST)) {
+		kickIRQ();
 	}
-	return ret;
 }
 
-int InstrumentContainer::write16(uint64_t addr, uint64_t value)
+void InstrumentContainer::kickIRQ()
 {
-	int ret = -EIO;
-	for (auto i : instruments) {
-		if (i->write16(addr, value) == 0) {
-			ret = 0;
-		}
+	uint64_t one = 1;
+
+	if (this->irq.event < 0) {
+		// delivered once attached to an event loop
+		return;
+	}
+	// never blocks: the counter would have to reach 2^64 - 1 first
+	if (write(this->irq.event, &one, sizeof(one)) != sizeof(one)) {
+		fprintf(stderr, "Error: could not wake up event loop\n");
 	}
-	return ret;
 }
 
-int InstrumentContainer::write8(uint64_t addr, uint64_t value)
+void InstrumentContainer::deliverIRQs()
 {
-	int ret = -EIO;
-	for (auto i : instruments) {
-		if (i->write8(addr, value) == 0) {
-			ret = 0;
+	// woken up again by endTransaction() or the window timer
+	if (__atomic_load_n(&this->irq.deferred, __ATOMIC_SEQ_CST) || this->irq.armed) {
+		return;
+	}
+
+	uint64_t window = __atomic_load_n(&this->irq.window, __ATOMIC_RELAXED);
+
+	if (window) {
+		uint64_t now = monotonic_ns();
+
+		if (now - this->irq.last < window) {
+			// lines raised meanwhile are merged into one notification
+			this->irq.armed = true;
+			this->loop->setTimer(this->irq.timer, window - (now - this->irq.last));
+			return;
 		}
+		this->irq.last = now;
+	}
+
+	uint64_t lines = __atomic_exchange_n(&this->irq.pending, 0, __ATOMIC_SEQ_CST);
+
+	if (lines) {
+		emitIRQ(lines);
 	}
-	return ret;
 }
 
-int InstrumentContainer::read32(uint64_t addr, uint64_t *value)
+int InstrumentContainer::attach(EventLoop *loop)
 {
-	int ret = -EIO;
-	*value = ~0;
-	for (auto i : instruments) {
-		uint64_t tmp;
-		if (i->read32(addr, &tmp) == 0) {
-			*value &= tmp;
-			ret = 0;
+	int event = eventfd(0, EFD_CLOEXEC | EFD_NONBLOCK);
+
+	if (event < 0) {
+		fprintf(stderr, "Error: could not create interrupt event (%d)\n", errno);
+		return -errno;
+	}
+
+	int r = loop->add(event, EPOLLIN, [this](uint32_t events) {
+		uint64_t count;
+
+		if (read(this->irq.event, &count, sizeof(count)) == sizeof(count)) {
+			deliverIRQs();
+		}
+	});
+
+	if (r != 0) {
+		close(event);
+		return r;
+	}
+
+	this->irq.timer = loop->addTimer([this] {
+		this->irq.armed = false;
+		deliverIRQs();
+	});
+	if (this->irq.timer < 0) {
+		loop->remove(event);
+		close(event);
+		return this->irq.timer;
+	}
+
+	this->loop = loop;
+	this->irq.event = event;
+	this->irq.armed = false;
+	this->attached = true;
+
+	for (auto &t : this->timers) {
+		t.id = loop->addTimer([this, &t] {
+			pthread_mutex_lock(&this->lock);
+			t.cb();
+			commit();
+			pthread_mutex_unlock(&this->lock);
+		});
+		if (t.id >= 0) {
+			loop->setTimer(t.id, t.period, t.period);
 		}
 	}
-	return ret;
+
+	// deliver whatever was raised before we were attached
+	kickIRQ();
+	return 0;
 }
 
-int InstrumentContainer::read16(uint64_t addr, uint64_t *value)
+void InstrumentContainer::detach()
 {
-	int ret = -EIO;
-	*value = ~0;
-	for (auto i : instruments) {
-		uint64_t tmp;
-		if (i->read16(addr, &tmp) == 0) {
-			*value &= tmp;
-			ret = 0;
+	if (!this->attached) {
+		return;
+	}
+	for (auto &t : this->timers) {
+		if (t.id >= 0) {
+			this->loop->removeTimer(t.id);
+			t.id = -1;
 		}
 	}
-	return ret;
+	this->loop->removeTimer(this->irq.timer);
+	this->loop->remove(this->irq.event);
+	close(this->irq.event);
+	this->irq.timer = -1;
+	this->irq.event = -1;
+	this->attached = false;
+}
+
+int InstrumentContainer::addTimer(uint64_t period_ns, std::function<void()> cb)
+{
+	if (period_ns == 0) {
+		return -EINVAL;
+	}
+	if (this->attached) {
+		// timers are registered before the container is served
+		return -EBUSY;
+	}
+	this->timers.push_back(Timer{ period_ns, std::move(cb), -1 });
+	return 0;
 }
 
-int InstrumentContainer::read8(uint64_t addr, uint64_t *value)
+int InstrumentContainer::startEventThread()
 {
-	int ret = -EIO;
-	*value = ~0;
-	for (auto i : instruments) {
-		uint64_t tmp;
-		if (i->read8(addr, &tmp) == 0) {
-			*value &= tmp;
-			ret = 0;
+	this->events.loop.reset(new EventLoop());
+	if (!this->events.loop->valid()) {
+		this->events.loop.reset();
+		return -EIO;
+	}
+
+	int r = attach(this->events.loop.get());
+
+	if (r != 0) {
+		this->events.loop.reset();
+		return r;
+	}
+
+	__atomic_store_n(&this->events.running, true, __ATOMIC_SEQ_CST);
+	if (pthread_create(&this->events.thread, NULL, _event_thread, this) != 0) {
+		this->events.running = false;
+		detach();
+		this->events.loop.reset();
+		return -EAGAIN;
+	}
+	return 0;
+}
+
+void InstrumentContainer::stopEventThread()
+{
+	if (!this->events.loop) {
+		return;
+	}
+	__atomic_store_n(&this->events.running, false, __ATOMIC_SEQ_CST);
+	this->events.loop->wakeup();
+	pthread_join(this->events.thread, NULL);
+	detach();
+	this->loop = NULL;
+	this->events.loop.reset();
+}
+
+void InstrumentContainer::beginTransaction()
+{
+	__atomic_store_n(&this->irq.deferred, true, __ATOMIC_SEQ_CST);
+}
+
+void InstrumentContainer::endTransaction()
+{
+	__atomic_store_n(&this->irq.deferred, false, __ATOMIC_SEQ_CST);
+	// anything raised after the flag was cleared kicks the thread itself
+	if (__atomic_load_n(&this->irq.pending, __ATOMIC_SEQ_CST) != 0) {
+		kickIRQ();
+	}
+}
+
+void InstrumentContainer::setIRQWindow(uint64_t ns)
+{
+	__atomic_store_n(&this->irq.window, ns, __ATOMIC_RELAXED);
+}
+
+int InstrumentContainer::addInstrument(IInstrument *i, uint64_t base, uint64_t size, unsigned irq)
+{
+	if (irq >= 64) {
+		fprintf(stderr, "Error: invalid interrupt line %u\n", irq);
+		return -EINVAL;
+	}
+
+	int r = this->map.add(base, size, i);
+
+	if (r != 0) {
+		fprintf(stderr, "Error: could not map instrument at %08x (size %08x)\n",
+			(uint32_t)base, (uint32_t)size);
+		return r;
+	}
+	i->onIRQ(std::bind(&InstrumentContainer::raiseIRQ, this, irq));
+	i->setupTimers([this](uint64_t period_ns, std::function<void()> cb) {
+		return addTimer(period_ns, std::move(cb));
+	});
+	i->setScheduler(&this->wheel);
+	this->instruments.push_back(i);
+
+	pthread_mutex_lock(&this->lock);
+	// never allocates on the request path
+	this->touched.list.reserve(this->instruments.size());
+	i->commit();
+	pthread_mutex_unlock(&this->lock);
+	return 0;
+}
+
+int InstrumentContainer::access(uint64_t addr, unsigned width, bool write, uint64_t *value)
+{
+	auto m = this->map.find(addr, width);
+
+	if (!m) {
+		// unmapped reads float high
+		if (!write) {
+			*value = ~0;
 		}
+		return -EIO;
 	}
-	return ret;
+	touch(m->target);
+	return m->target->access(addr - m->base, width, write, value);
 }
 
-int InstrumentContainer::handleBusRequests()
+int InstrumentContainer::writeBlock(uint64_t addr, const uint8_t *data, size_t len)
 {
-	struct instrulink *instrulink = this->instrulink;
-	struct instrulink_packet req;
-	struct instrulink_packet res;
+	auto m = this->map.find(addr, len);
 
-	if (instrulink_wait_request(instrulink, &req) != 0) {
-		fprintf(stderr, "Failed to receive packet\n");
+	if (!m) {
 		return -EIO;
 	}
+	touch(m->target);
+	return m->target->writeBlock(addr - m->base, data, len);
+}
 
-	pthread_mutex_lock(&this->lock);
+int InstrumentContainer::readBlock(uint64_t addr, uint8_t *data, size_t len)
+{
+	auto m = this->map.find(addr, len);
 
-	uint64_t value = ~0;
-	res.value = ~0;
-	res.type = MSG_TYPE_ERROR;
+	if (!m) {
+		return -EIO;
+	}
+	touch(m->target);
+	return m->target->readBlock(addr - m->base, data, len);
+}
 
-	switch (req.type) {
-	case MSG_TYPE_HANDSHAKE:
-		res.type = MSG_TYPE_HANDSHAKE;
-		break;
-	case MSG_TYPE_WRITE8:
-		if (write8(req.addr, req.value) != 0) {
-			fprintf(stderr, "Error: failed write8 to %08x\n", (uint32_t)req.addr);
+void InstrumentContainer::commit()
+{
+	for (auto i : this->instruments) {
+		i->commit();
+	}
+	this->touched.list.clear();
+	this->touched.all = false;
+}
+
+void InstrumentContainer::touch(IInstrument *i)
+{
+	// a request rarely touches more than a handful of instruments
+	if (std::find(this->touched.list.begin(), this->touched.list.end(), i) ==
+	    this->touched.list.end()) {
+		this->touched.list.push_back(i);
+	}
+}
+
+void InstrumentContainer::commitTouched()
+{
+	if (this->touched.all) {
+		commit();
+		return;
+	}
+	for (auto i : this->touched.list) {
+		i->commit();
+	}
+	this->touched.list.clear();
+}
+
+void InstrumentContainer::advance(uint64_t ns)
+{
+	uint64_t end = this->time + ns;
+
+	// every instrument may have changed in the quantum
+	this->touched.all = true;
+
+	// idle time between events is skipped in one step
+	for (uint64_t next = this->wheel.next(); next <= end; next = this->wheel.next()) {
+		if (next > this->time) {
+			advanceInstruments(next - this->time);
+			__atomic_store_n(&this->time, next, __ATOMIC_RELAXED);
+		}
+		this->wheel.run(next);
+	}
+	if (end > this->time) {
+		advanceInstruments(end - this->time);
+	}
+	this->wheel.run(end);
+	__atomic_store_n(&this->time, end, __ATOMIC_RELAXED);
+	runInstruments([](IInstrument *i) { i->endQuantum(); });
+}
+
+void InstrumentContainer::advanceInstruments(uint64_t ns)
+{
+	runInstruments([ns](IInstrument *i) { i->advance(ns); });
+}
+
+void InstrumentContainer::runInstruments(const std::function<void(IInstrument *)> &fn)
+{
+	if (this->pool) {
+		this->pool->run(this->instruments.size(),
+				[this, &fn](size_t c) { fn(this->instruments[c]); });
+	} else {
+		for (auto i : this->instruments) {
+			fn(i);
+		}
+	}
+}
+
+void InstrumentContainer::handleRequest(const struct instrulink_packet *req,
+					struct instrulink_packet *res)
+{
+	uint64_t value = req->value;
+	unsigned width;
+	bool write;
+
+	res->addr = req->addr;
+	res->value = ~0;
+	res->type = MSG_TYPE_ERROR;
+
+	if (decodeAccess(req->type, &width, &write)) {
+		if (access(req->addr, width, write, &value) != 0) {
+			fprintf(stderr, "Error: failed %s%u %s %08x\n", write ? "write" : "read",
+				width * 8, write ? "to" : "from", (uint32_t)req->addr);
+			postedWriteFailed(req);
 		} else {
-			res.type = MSG_TYPE_OK;
+			res->type = MSG_TYPE_OK;
+			if (!write) {
+				res->value = value;
+			}
 		}
+		return;
+	}
+
+	switch (req->type) {
+	case MSG_TYPE_HANDSHAKE:
+		res->type = MSG_TYPE_HANDSHAKE;
 		break;
-	case MSG_TYPE_WRITE16:
-		if (write16(req.addr, req.value) != 0) {
-			fprintf(stderr, "Error: failed write8 to %08x\n", (uint32_t)req.addr);
+	case MSG_TYPE_TICK_CLOCK:
+		advance(req->value);
+		res->type = MSG_TYPE_OK;
+		res->value = this->time;
+		break;
+	case MSG_TYPE_FENCE:
+		// posted writes are applied in order so they are all done by now
+		if (this->posted.errors == 0) {
+			res->type = MSG_TYPE_OK;
+			res->value = 0;
 		} else {
-			res.type = MSG_TYPE_OK;
+			res->addr = this->posted.addr;
+			res->value = this->posted.errors;
 		}
+		this->posted.errors = 0;
 		break;
-	case MSG_TYPE_WRITE32:
-		if (write32(req.addr, req.value) != 0) {
-			fprintf(stderr, "Error: failed write8 to %08x\n", (uint32_t)req.addr);
-		} else {
-			res.type = MSG_TYPE_OK;
+	case MSG_TYPE_CACHEABLE: {
+		auto regions = cacheableRegions();
+
+		if (req->addr < regions.size()) {
+			res->type = MSG_TYPE_OK;
+			res->addr = regions[req->addr].base;
+			res->value = regions[req->addr].size;
 		}
 		break;
-	case MSG_TYPE_READ8:
-		if (read8(req.addr, &value) != 0) {
-			fprintf(stderr, "Error: failed read8 from %08x\n", (uint32_t)req.addr);
-		} else {
-			res.value &= ~value;
-			res.type = MSG_TYPE_OK;
+	}
+	case MSG_TYPE_DISCONNECT:
+		__atomic_store_n(&this->is_running, false, __ATOMIC_RELEASE);
+	}
+}
+
+bool InstrumentContainer::peekRequest(const struct instrulink_packet *req,
+				      struct instrulink_packet *res)
+{
+	unsigned width;
+	bool write;
+
+	if (!decodeAccess(req->type, &width, &write) || write) {
+		return false;
+	}
+
+	auto m = this->map.find(req->addr, width);
+	uint64_t value;
+
+	if (!m || m->target->peek(req->addr - m->base, width, &value) != 0) {
+		return false;
+	}
+	res->type = MSG_TYPE_OK;
+	res->addr = req->addr;
+	res->value = value;
+	return true;
+}
+
+std::vector<IInstrument::Region> InstrumentContainer::cacheableRegions()
+{
+	std::vector<IInstrument::Region> regions;
+
+	for (auto &m : this->map.mappings()) {
+		for (auto &r : m.target->cacheable()) {
+			if (r.base >= m.size) {
+				continue;
+			}
+
+			uint64_t base = m.base + r.base;
+			uint64_t size = std::min(r.size, m.size - r.base);
+
+			// adjacent regions of neighbouring instruments are merged
+			if (!regions.empty() && regions.back().base + regions.back().size == base) {
+				regions.back().size += size;
+			} else {
+				regions.push_back(IInstrument::Region{ base, size });
+			}
 		}
+	}
+	return regions;
+}
+
+void InstrumentContainer::postedWriteFailed(const struct instrulink_packet *req)
+{
+	if (!isPostedWrite(req->type)) {
+		return;
+	}
+	if (this->posted.errors++ == 0) {
+		this->posted.addr = req->addr;
+	}
+}
+
+bool InstrumentContainer::isPostedWrite(uint32_t type)
+{
+	return type == MSG_TYPE_POSTED_WRITE8 || type == MSG_TYPE_POSTED_WRITE16 ||
+	       type == MSG_TYPE_POSTED_WRITE32;
+}
+
+bool InstrumentContainer::decodeAccess(uint32_t type, unsigned *width, bool *write)
+{
+	switch (type) {
+	case MSG_TYPE_WRITE8:
+	case MSG_TYPE_POSTED_WRITE8:
+	case MSG_TYPE_READ8:
+		*width = sizeof(uint8_t);
 		break;
+	case MSG_TYPE_WRITE16:
+	case MSG_TYPE_POSTED_WRITE16:
 	case MSG_TYPE_READ16:
-		if (read16(req.addr, &value) != 0) {
-			fprintf(stderr, "Error: failed read16 from %08x\n", (uint32_t)req.addr);
-		} else {
-			res.value &= value;
-			res.type = MSG_TYPE_OK;
-		}
+		*width = sizeof(uint16_t);
 		break;
+	case MSG_TYPE_WRITE32:
+	case MSG_TYPE_POSTED_WRITE32:
 	case MSG_TYPE_READ32:
-		if (read32(req.addr, &value) != 0) {
-			fprintf(stderr, "Error: failed read32 from %08x\n", (uint32_t)req.addr);
-		} else {
-			res.value &= value;
-			res.type = MSG_TYPE_OK;
-		}
+		*width = sizeof(uint32_t);
 		break;
-	case MSG_TYPE_DISCONNECT:
-		this->is_running = false;
+	default:
+		return false;
+	}
+	*write = type != MSG_TYPE_READ8 && type != MSG_TYPE_READ16 && type != MSG_TYPE_READ32;
+	return true;
+}
+
+int InstrumentContainer::handleBatch(const struct instrulink_packet *req)
+{
+	struct instrulink *instrulink = this->instrulink;
+	struct instrulink_packet *ops = this->batch.ops;
+	struct instrulink_packet *res = this->batch.res;
+	size_t count = req->value;
+
+	if (count == 0 || count > INSTRULINK_BATCH_MAX) {
+		// we can not resynchronize with the stream after this
+		fprintf(stderr, "Error: invalid batch size %u\n", (uint32_t)count);
+		return -EINVAL;
+	}
+
+	if (instrulink_wait_batch(instrulink, ops, count) != 0) {
+		fprintf(stderr, "Failed to receive batch\n");
+		return -EIO;
+	}
+
+	pthread_mutex_lock(&this->lock);
+
+	executeBatch(ops, res, count);
+	commitTouched();
+
+	pthread_mutex_unlock(&this->lock);
+
+	if (instrulink_send_batch_response(instrulink, res, count) != 0) {
+		fprintf(stderr, "Failed to send batch response\n");
+		return -EIO;
+	}
+	return 0;
+}
+
+void InstrumentContainer::executeBatch(const struct instrulink_packet *ops,
+				       struct instrulink_packet *res, size_t count)
+{
+	for (size_t c = 0; c < count; c++) {
+		struct instrulink_packet op = ops[c];
+
+		if (op.type == MSG_TYPE_BATCH || op.type == MSG_TYPE_READ_BLOCK ||
+		    op.type == MSG_TYPE_WRITE_BLOCK) {
+			// batches can not be nested and have no room for block payloads
+			res[c].type = MSG_TYPE_ERROR;
+			res[c].addr = op.addr;
+			res[c].value = ~0;
+			continue;
+		}
+
+		// every operation is answered in the batch response so posted writes
+		// run as plain writes and their errors are not reported again by a fence
+		switch (op.type) {
+		case MSG_TYPE_POSTED_WRITE32:
+			op.type = MSG_TYPE_WRITE32;
+			break;
+		case MSG_TYPE_POSTED_WRITE16:
+			op.type = MSG_TYPE_WRITE16;
+			break;
+		case MSG_TYPE_POSTED_WRITE8:
+			op.type = MSG_TYPE_WRITE8;
+			break;
+		}
+		handleRequest(&op, &res[c]);
+	}
+}
+
+int InstrumentContainer::handleBlock(const struct instrulink_packet *req)
+{
+	struct instrulink *instrulink = this->instrulink;
+	struct instrulink_packet res;
+	uint8_t *data = this->block;
+	size_t len = req->value;
+	int r;
+
+	if (len > INSTRULINK_BLOCK_MAX) {
+		// we can not resynchronize with the stream after this
+		fprintf(stderr, "Error: invalid block size %u\n", (uint32_t)len);
+		return -EINVAL;
+	}
+
+	if (req->type == MSG_TYPE_WRITE_BLOCK && instrulink_wait_block(instrulink, data, len) != 0) {
+		fprintf(stderr, "Failed to receive block\n");
+		return -EIO;
+	}
+
+	pthread_mutex_lock(&this->lock);
+
+	if (req->type == MSG_TYPE_WRITE_BLOCK) {
+		r = writeBlock(req->addr, data, len);
+	} else {
+		r = readBlock(req->addr, data, len);
 	}
+	commitTouched();
 
 	pthread_mutex_unlock(&this->lock);
 
-	if (instrulink_send_response(instrulink, &res) != 0) {
+	res.addr = req->addr;
+	res.value = 0;
+	res.type = MSG_TYPE_OK;
+
+	if (r != 0) {
+		fprintf(stderr, "Error: failed block access to %08x (%u bytes)\n",
+			(uint32_t)req->addr, (uint32_t)len);
+		res.type = MSG_TYPE_ERROR;
+		r = instrulink_send_response(instrulink, &res);
+	} else if (req->type == MSG_TYPE_READ_BLOCK) {
+		res.value = len;
+		r = instrulink_send_block_response(instrulink, &res, data, len);
+	} else {
+		r = instrulink_send_response(instrulink, &res);
+	}
+
+	if (r != 0) {
 		fprintf(stderr, "Failed to send packet");
 		return -EIO;
 	}
 	return 0;
 }
 
+int InstrumentContainer::handleBusRequests()
+{
+	struct instrulink *instrulink = this->instrulink;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+
+	if (instrulink_wait_request(instrulink, &req) != 0) {
+		fprintf(stderr, "Failed to receive packet\n");
+		return -EIO;
+	}
+
+	// service time is only measured when asked for so the default path stays free of clock reads
+	uint64_t start = isRealTime() ? monotonic_ns() : 0;
+	int r = 0;
+
+	beginTransaction();
+
+	if (req.type == MSG_TYPE_BATCH) {
+		r = handleBatch(&req);
+	} else if (req.type == MSG_TYPE_READ_BLOCK || req.type == MSG_TYPE_WRITE_BLOCK) {
+		r = handleBlock(&req);
+	} else {
+		// reads without side effects are answered from the snapshots without the lock
+		if (!peekRequest(&req, &res)) {
+			pthread_mutex_lock(&this->lock);
+
+			handleRequest(&req, &res);
+			commitTouched();
+
+			pthread_mutex_unlock(&this->lock);
+		}
+
+		// errors of posted writes are reported by the next fence
+		if (!isPostedWrite(req.type) && instrulink_send_response(instrulink, &res) != 0) {
+			fprintf(stderr, "Failed to send packet");
+			r = -EIO;
+		}
+	}
+
+	// interrupts raised by the transaction go out in one notification
+	endTransaction();
+
+	if (start) {
+		recordLatency(start);
+	}
+	return r;
+}
+
+void InstrumentContainer::recordLatency(uint64_t start)
+{
+	uint64_t ns = monotonic_ns() - start;
+
+	// single writer: relaxed stores keep readers on other threads free of torn values
+	__atomic_store_n(&this->stats.requests, this->stats.requests + 1, __ATOMIC_RELAXED);
+	__atomic_store_n(&this->stats.total, this->stats.total + ns, __ATOMIC_RELAXED);
+	if (ns > this->stats.worst) {
+		__atomic_store_n(&this->stats.worst, ns, __ATOMIC_RELAXED);
+	}
+}
+
+void InstrumentContainer::setRealTime(int cpu, int priority)
+{
+	this->options.rt_cpu = cpu;
+	this->options.rt_priority = priority;
+}
+
+void InstrumentContainer::setBusyPoll(unsigned us)
+{
+	this->options.busy_poll = us;
+	if (this->instrulink) {
+		instrulink_set_busy_poll(this->instrulink, us);
+	}
+}
+
+unsigned InstrumentContainer::busyPoll()
+{
+	return this->options.busy_poll;
+}
+
+void InstrumentContainer::setTickThreads(unsigned threads)
+{
+	this->pool.reset(threads ? new TickPool(threads) : NULL);
+}
+
+bool InstrumentContainer::isRealTime()
+{
+	return this->options.rt_cpu >= 0 || this->options.rt_priority > 0;
+}
+
+InstrumentContainer::LatencyStats InstrumentContainer::latency()
+{
+	LatencyStats s;
+
+	s.requests = __atomic_load_n(&this->stats.requests, __ATOMIC_RELAXED);
+	s.worst = __atomic_load_n(&this->stats.worst, __ATOMIC_RELAXED);
+	s.total = __atomic_load_n(&this->stats.total, __ATOMIC_RELAXED);
+	return s;
+}
+
+unsigned InstrumentContainer::enterRealTime()
+{
+	unsigned flags = 0;
+	int r;
+
+	if (this->options.rt_cpu >= 0) {
+		r = realtime_pin(this->options.rt_cpu);
+		if (r == 0) {
+			flags |= REALTIME_PINNED;
+		} else {
+			fprintf(stderr, "Warning: could not pin bus thread to cpu %d (%s)\n",
+				this->options.rt_cpu, strerror(-r));
+		}
+	}
+	if (this->options.rt_priority > 0) {
+		r = setRealTimePriority(this->options.rt_priority);
+		if (r == 0) {
+			flags |= REALTIME_FIFO;
+		} else {
+			fprintf(stderr,
+				"Warning: could not set SCHED_FIFO priority %d (%s), "
+				"needs CAP_SYS_NICE or RLIMIT_RTPRIO; using normal scheduling\n",
+				this->options.rt_priority, strerror(-r));
+		}
+	}
+
+	r = lockMemory(REALTIME_HEAP_SIZE);
+	if (r == 0) {
+		flags |= REALTIME_LOCKED;
+	} else {
+		fprintf(stderr,
+			"Warning: could not lock memory (%s), needs CAP_IPC_LOCK or "
+			"RLIMIT_MEMLOCK; page faults may add latency\n",
+			strerror(-r));
+	}
+
+	// touch the stack and the buffers used on the bus path once before serving
+	realtime_prefault_stack(REALTIME_STACK_SIZE);
+	if (this->instrulink) {
+		instrulink_prefault(this->instrulink);
+	}
+
+	printf("Real-time mode:%s%s%s\n", (flags & REALTIME_PINNED) ? " pinned" : "",
+	       (flags & REALTIME_FIFO) ? " fifo" : "", (flags & REALTIME_LOCKED) ? " locked" : "");
+	return flags;
+}
+
+int InstrumentContainer::setRealTimePriority(int priority)
+{
+	return realtime_set_fifo(priority);
+}
+
+int InstrumentContainer::lockMemory(size_t heap)
+{
+	return realtime_lock_memory(heap);
+}
+
 bool InstrumentContainer::isRunning()
 {
-	return this->is_running;
+	return __atomic_load_n(&this->is_running, __ATOMIC_ACQUIRE);
+}
+
+int InstrumentContainer::serve()
+{
+	for (;;) {
+		// requests are only handled once all of them has arrived so a simulator
+		// stopping halfway through one never blocks the loop thread
+		int r = instrulink_receive(this->instrulink);
+
+		if (!instrulink_pending(this->instrulink)) {
+			// responses held back for the rest of the burst go out before waiting again
+			int f = instrulink_flush(this->instrulink);
+
+			return r != 0 ? r : f;
+		}
+
+		// drain everything already buffered so one wakeup serves a whole burst
+		do {
+			if (handleBusRequests() != 0) {
+				return -EIO;
+			}
+		} while (isRunning() && instrulink_pending(this->instrulink));
+
+		if (!isRunning()) {
+			return instrulink_flush(this->instrulink);
+		}
+	}
+}
+
+int InstrumentContainer::busFd()
+{
+	return instrulink_fd(this->instrulink);
+}
+
+int InstrumentContainer::irqFd()
+{
+	return instrulink_irq_fd(this->instrulink);
+}
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options] <mainPort> <irqPort> <address>\n", prog);
+	printf("       %s [options] unix <mainPath> <irqPath>\n", prog);
+	printf("       %s [options] shm <name|fd:N>\n", prog);
+	printf("Options:\n");
+	printf("  --headless        serve instrulink without opening a window\n");
+	printf("  --telemetry <ms>  print instrument registers every <ms> milliseconds\n");
+	printf("  --tick-threads <n> advance instruments in parallel on <n> extra threads\n");
+	printf("  --busy-poll <us>  spin up to <us> microseconds for requests before blocking\n");
+	printf("  --rt-cpu <n>      real-time mode: pin the bus thread to core <n>\n");
+	printf("  --rt-priority <p> real-time mode: run the bus thread with SCHED_FIFO priority <p>\n");
+}
+
+/** Parses a --tick-threads count, at most one extra thread per online CPU */
+static int parseTickThreads(const char *arg, unsigned *threads)
+{
+	long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+	unsigned long max = cpus > 0 ? (unsigned long)cpus : 1;
+	char *end;
+
+	errno = 0;
+	unsigned long n = strtoul(arg, &end, 10);
+
+	if (arg[0] < '0' || arg[0] > '9' || *end != '\0' || errno != 0 || n > max) {
+		fprintf(stderr, "Error: invalid tick thread count %s (0 to %lu)\n", arg, max);
+		return -1;
+	}
+	*threads = n;
+	return 0;
 }
 
 int InstrumentContainer::init(int argc, char **argv)
 {
-	if (argc != 4) {
-		printf("Usage: %s <mainPort> <irqPort> <address>\n", argv[0]);
+	const char *prog = argv[0];
+
+	// options come before the connection arguments
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--headless") == 0) {
+			this->options.headless = true;
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "--telemetry") == 0 && argc > 2) {
+			this->options.telemetry = atoi(argv[2]);
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "--tick-threads") == 0 && argc > 2) {
+			unsigned threads;
+
+			if (parseTickThreads(argv[2], &threads) != 0) {
+				return -1;
+			}
+			setTickThreads(threads);
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "--busy-poll") == 0 && argc > 2) {
+			this->options.busy_poll = atoi(argv[2]);
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "--rt-cpu") == 0 && argc > 2) {
+			this->options.rt_cpu = atoi(argv[2]);
+			argv += 2;
+			argc -= 2;
+		} else if (strcmp(argv[1], "--rt-priority") == 0 && argc > 2) {
+			this->options.rt_priority = atoi(argv[2]);
+			argv += 2;
+			argc -= 2;
+		} else {
+			usage(prog);
+			return -1;
+		}
+	}
+
+	if (argc == 3 && strcmp(argv[1], "shm") == 0) {
+		const char *name = argv[2];
+
+		if (instrulink_connect_shm(this->instrulink, name) != 0) {
+			fprintf(stderr, "Could not connect to instrulink (shm: %s)\n", name);
+			return -1;
+		}
+		printf("Connected to shared memory %s\n", name);
+	} else if (argc == 4 && strcmp(argv[1], "unix") == 0) {
+		const char *mainPath = argv[2];
+		const char *irqPath = argv[3];
+
+		if (instrulink_connect_unix(this->instrulink, mainPath, irqPath) != 0) {
+			fprintf(stderr, "Could not connect to instrulink (unix: %s)\n", mainPath);
+			return -1;
+		}
+		printf("Connected to %s %s\n", mainPath, irqPath);
+	} else if (argc != 4) {
+		usage(prog);
 		return -1;
 	} else {
 		int mainPort = atoi(argv[1]);
@@ -238,116 +985,87 @@ int InstrumentContainer::init(int argc, char **argv)
 		printf("Connected to %s %d %d\n", address, mainPort, irqPort);
 	}
 
-	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0) {
-		printf("Error: %s\n", SDL_GetError());
-		return -1;
-	}
-
-	// GL 3.0 + GLSL 130
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
-	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
-
-	// Create window with graphics context
-	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
-	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
-	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
-
 	return 0;
 }
 
-int InstrumentContainer::show()
-{
-	SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE |
-							 SDL_WINDOW_ALLOW_HIGHDPI);
-	SDL_Window *window = SDL_CreateWindow("Controller example", SDL_WINDOWPOS_CENTERED,
-					      SDL_WINDOWPOS_CENTERED, 1280, 720, window_flags);
-	SDL_GLContext gl_context = SDL_GL_CreateContext(window);
-	SDL_GL_MakeCurrent(window, gl_context);
-	SDL_GL_SetSwapInterval(1); // Enable vsync
-
-	// Setup Dear ImGui context
-	IMGUI_CHECKVERSION();
-	ImGui::CreateContext();
-	ImPlot::CreateContext();
-	ImGuiIO &io = ImGui::GetIO();
-	(void)io;
-
-	// Setup Dear ImGui style
-	ImGui::StyleColorsDark();
-
-	// Setup Platform/Renderer backends
-	ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
-	ImGui_ImplOpenGL3_Init("#version 130");
-	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
-
-	this->is_running = true;
-
-	pthread_t thread;
-	pthread_create(&thread, NULL, _communication_thread, this);
-	while (this->is_running) {
-		SDL_Event event;
-		while (SDL_PollEvent(&event)) {
-			ImGui_ImplSDL2_ProcessEvent(&event);
-			if (event.type == SDL_QUIT) {
-				this->is_running = false;
-			}
-			if (event.type == SDL_WINDOWEVENT &&
-			    event.window.event == SDL_WINDOWEVENT_CLOSE &&
-			    event.window.windowID == SDL_GetWindowID(window)) {
-				this->is_running = false;
-			}
-		}
-
-		// Start the Dear ImGui frame
-		ImGui_ImplOpenGL3_NewFrame();
-		ImGui_ImplSDL2_NewFrame();
-		ImGui::NewFrame();
+bool InstrumentContainer::isHeadless()
+{
+	return this->options.headless;
+}
 
-		ImGui::SetNextWindowPos(ImVec2(0.0, 0.0));
-		ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
-		ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+unsigned InstrumentContainer::telemetryPeriod()
+{
+	return this->options.telemetry;
+}
 
-		// Instrument render begin
-		ImGui::Begin("Memory view", NULL,
-			     ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration);
+void InstrumentContainer::printTelemetry(FILE *out, unsigned index)
+{
+	// snapshots are published by the bus thread so no lock is needed
+	uint64_t time = __atomic_load_n(&this->time, __ATOMIC_RELAXED);
+	unsigned c = 0;
 
-		pthread_mutex_lock(&this->lock);
+	for (auto i : this->instruments) {
+		fprintf(out, "%llu %u.%u ", (unsigned long long)time, index, c++);
+		i->telemetry(out);
+	}
+}
 
-		for (auto i : this->instruments) {
-			i->render();
-		}
+int InstrumentContainer::start()
+{
+	if (!this->instrulink) {
+		return -ENOTCONN;
+	}
+	instrulink_set_busy_poll(this->instrulink, this->options.busy_poll);
+	// polled channels are served by an event loop shared with other connections
+	if (busFd() >= 0 && instrulink_set_nonblocking(this->instrulink) != 0) {
+		return -EIO;
+	}
+	__atomic_store_n(&this->is_running, true, __ATOMIC_RELEASE);
+	return 0;
+}
 
-		pthread_mutex_unlock(&this->lock);
+void InstrumentContainer::halt()
+{
+	__atomic_store_n(&this->is_running, false, __ATOMIC_RELEASE);
+	// a thread blocked on a channel that can not be polled would never notice
+	if (this->instrulink) {
+		instrulink_shutdown(this->instrulink);
+	}
+}
 
-		ImGui::End();
-		ImGui::PopStyleVar(1);
+void InstrumentContainer::stop()
+{
+	if (isRealTime()) {
+		LatencyStats s = latency();
 
-		// Rendering
-		ImGui::Render();
-		glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
-		glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w,
-			     clear_color.z * clear_color.w, clear_color.w);
-		glClear(GL_COLOR_BUFFER_BIT);
-		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
-		SDL_GL_SwapWindow(window);
+		printf("Worst case request service latency: %llu ns (%llu requests, average %llu ns)\n",
+		       (unsigned long long)s.worst, (unsigned long long)s.requests,
+		       (unsigned long long)(s.requests ? s.total / s.requests : 0));
 	}
 
-	this->is_running = false;
-	pthread_join(thread, NULL);
+	halt();
+	stopEventThread();
+	detach();
 
-	instrulink_disconnect(this->instrulink);
-	instrulink_free(&this->instrulink);
+	if (this->instrulink && this->options.busy_poll) {
+		struct instrulink_wait_stats ws;
 
-	ImPlot::DestroyContext();
-	ImGui_ImplOpenGL3_Shutdown();
-	ImGui_ImplSDL2_Shutdown();
-	ImGui::DestroyContext();
+		instrulink_get_wait_stats(this->instrulink, &ws);
+		printf("Busy poll: %llu waits satisfied while polling, %llu blocked\n",
+		       (unsigned long long)ws.polled, (unsigned long long)ws.blocked);
+	}
 
-	SDL_GL_DeleteContext(gl_context);
-	SDL_DestroyWindow(window);
-	SDL_Quit();
+	if (this->instrulink) {
+		instrulink_disconnect(this->instrulink);
+		instrulink_free(&this->instrulink);
+	}
+}
 
-	return 0;
+int InstrumentContainer::run()
+{
+	InstrumentHost host;
+
+	host.setTelemetry(this->options.telemetry);
+	host.addContainer(this);
+	return host.run();
 }
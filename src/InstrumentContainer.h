@@ -6,29 +6,256 @@
  * Training: https://swedishembedded.com/tag/training
  **/
 
+#pragma once
+
 #include "BaseInstrument.h"
+#include "AddressMap.h"
+#include "EventLoop.h"
+#include "TickPool.h"
+#include "TimingWheel.h"
+#include <instruments/protocol/protocol.h>
 #include <pthread.h>
-#include <list>
+#include <memory>
+#include <vector>
+
+void *_communication_thread(void *data);
+void *_event_thread(void *data);
+
+class InstrumentHost;
 
 class InstrumentContainer {
     public:
 	InstrumentContainer();
+	/**
+	 * \brief Parse command line options and connect to the simulator
+	 * \details Accepts --headless and --telemetry <ms> before the connection arguments.
+	 **/
 	int init(int argc, char **argv);
-	int addInstrument(IInstrument *i);
+	/**
+	 * \brief Map an instrument into the address space of the container
+	 * \param i instrument to add
+	 * \param base first bus address decoded to the instrument
+	 * \param size size of the register window in bytes
+	 * \param irq interrupt line raised by the instrument (0-63)
+	 * \returns 0 on success or negative on error
+	 * \retval -EEXIST window overlaps an already added instrument
+	 * \retval -EINVAL invalid window or interrupt line
+	 **/
+	int addInstrument(IInstrument *i, uint64_t base, uint64_t size, unsigned irq = 0);
+	/**
+	 * \brief Set interrupt coalescing window
+	 * \details Interrupts raised within ns of the previous notification are
+	 * held back and sent together in one notification. Interrupts raised
+	 * while a bus transaction is executed are always sent together after
+	 * the response.
+	 * \param ns length of the window in nanoseconds (0 disables the window)
+	 **/
+	void setIRQWindow(uint64_t ns);
+	/**
+	 * \brief Call cb periodically on the event loop with the container lock held
+	 * \details Timers run at wall clock cadence independent of rendering and of
+	 * the simulator. Instruments register their timers in setupTimers().
+	 * \param period_ns time between calls in nanoseconds
+	 * \param cb callback
+	 * \returns 0 on success or negative on error
+	 **/
+	int addTimer(uint64_t period_ns, std::function<void()> cb);
+	/**
+	 * \brief Serve the simulator and render instruments until the window is closed
+	 * \details Part of the GUI library. Falls back to run() when started with --headless.
+	 **/
 	int show();
+	/**
+	 * \brief Serve the simulator from the calling thread until it disconnects
+	 * \details Headless run loop that does not need SDL or ImGui. Prints
+	 * telemetry of all instruments when enabled with --telemetry.
+	 **/
+	int run();
+	bool isHeadless();
+	/** Telemetry period requested with --telemetry in milliseconds (0 if disabled) */
+	unsigned telemetryPeriod();
+	/**
+	 * \brief Enable real-time mode for the thread serving the bus
+	 * \details The thread is pinned to cpu and runs with SCHED_FIFO at
+	 * priority. Memory of the process is locked and stacks and buffers are
+	 * pre-faulted. Steps that are not permitted are reported and skipped.
+	 * Also enabled with --rt-cpu and --rt-priority.
+	 * \param cpu core to pin the thread to (-1 to not pin)
+	 * \param priority SCHED_FIFO priority (0 to keep normal scheduling)
+	 **/
+	void setRealTime(int cpu, int priority);
+	bool isRealTime();
+	/**
+	 * \brief Spin for us microseconds waiting for a request before blocking
+	 * \details Also set with --busy-poll. Statistics on how waits were
+	 * satisfied are printed when the container stops.
+	 **/
+	void setBusyPoll(unsigned us);
+	unsigned busyPoll();
+	/**
+	 * \brief Advance instruments in parallel
+	 * \details Every quantum granted with TICK_CLOCK advances all instruments
+	 * concurrently on threads threads plus the bus thread and waits for all of
+	 * them before responding. Instruments must not share state in advance()
+	 * or endQuantum(). Lazily clocked models run their cycles in endQuantum()
+	 * so that is where the threads pay off for them.
+	 * Also set with --tick-threads.
+	 * \param threads number of extra threads (0 advances instruments one by one)
+	 **/
+	void setTickThreads(unsigned threads);
+	/**
+	 * \brief Apply real-time settings to the calling thread (used by threads serving the bus)
+	 * \returns REALTIME_* flags of the settings that took effect
+	 **/
+	unsigned enterRealTime();
+	/** Service time of requests measured in real-time mode */
+	struct LatencyStats {
+		/** Number of requests served */
+		uint64_t requests;
+		/** Longest time from receiving a request to sending the response in ns */
+		uint64_t worst;
+		/** Sum of all service times in ns */
+		uint64_t total;
+	};
+	LatencyStats latency();
+	/** Regions of the address space that the simulator may cache, sorted by address */
+	std::vector<IInstrument::Region> cacheableRegions();
 	friend void *_communication_thread(void *data);
+	friend void *_event_thread(void *data);
+	friend class InstrumentHost;
 
     protected:
-	int write32(uint64_t addr, uint64_t data);
-	int write16(uint64_t addr, uint64_t data);
-	int write8(uint64_t addr, uint64_t data);
-	int read32(uint64_t addr, uint64_t *data);
-	int read16(uint64_t addr, uint64_t *data);
-	int read8(uint64_t addr, uint64_t *data);
+	/**
+	 * \brief Read or write the register of the instrument mapped at addr
+	 * \param width access size in bytes (1, 2 or 4)
+	 * \retval -EIO address is not mapped (reads return all ones)
+	 **/
+	int access(uint64_t addr, unsigned width, bool write, uint64_t *data);
+	int write32(uint64_t addr, uint64_t data)
+	{
+		return access(addr, sizeof(uint32_t), true, &data);
+	}
+	int write16(uint64_t addr, uint64_t data)
+	{
+		return access(addr, sizeof(uint16_t), true, &data);
+	}
+	int write8(uint64_t addr, uint64_t data)
+	{
+		return access(addr, sizeof(uint8_t), true, &data);
+	}
+	int read32(uint64_t addr, uint64_t *data)
+	{
+		return access(addr, sizeof(uint32_t), false, data);
+	}
+	int read16(uint64_t addr, uint64_t *data)
+	{
+		return access(addr, sizeof(uint16_t), false, data);
+	}
+	int read8(uint64_t addr, uint64_t *data)
+	{
+		return access(addr, sizeof(uint8_t), false, data);
+	}
+	int writeBlock(uint64_t addr, const uint8_t *data, size_t len);
+	int readBlock(uint64_t addr, uint8_t *data, size_t len);
+	/** Apply edits and publish snapshots of all instruments. Must be called with lock held. */
+	void commit();
+	/**
+	 * \brief Commit only the instruments touched since the last commit
+	 * \details Bus accesses record the instrument they were decoded to so
+	 * that a register access does not publish every register file. Advancing
+	 * time touches all of them. Must be called with lock held.
+	 **/
+	void commitTouched();
+	/** Record that a bus access reached an instrument */
+	void touch(IInstrument *i);
+	/**
+	 * \brief Advance simulated time by a quantum. Must be called with lock held.
+	 * \details Scheduled events fire at their time within the quantum and all
+	 * instruments are advanced up to that time before each event. Each
+	 * instrument is told when the quantum ends with endQuantum().
+	 **/
+	void advance(uint64_t ns);
+	/** Advance all instruments by ns. Must be called with lock held. */
+	void advanceInstruments(uint64_t ns);
+	/** Call fn for every instrument, on the tick pool if there is one */
+	void runInstruments(const std::function<void(IInstrument *)> &fn);
 
 	bool isRunning();
 	int handleBusRequests();
-	void emitIRQ();
+	/**
+	 * \brief Answer a read without side effects from the published snapshots
+	 * \details Called without the lock held.
+	 * \returns false if the request has to be executed with handleRequest()
+	 **/
+	bool peekRequest(const struct instrulink_packet *req, struct instrulink_packet *res);
+	/** Execute a single request. Must be called with lock held. */
+	void handleRequest(const struct instrulink_packet *req, struct instrulink_packet *res);
+	/** Record failure of a posted write for the next fence */
+	void postedWriteFailed(const struct instrulink_packet *req);
+	static bool isPostedWrite(uint32_t type);
+	/**
+	 * \brief Decode a register access request
+	 * \param width set to the access size in bytes
+	 * \param write set to true for writes
+	 * \returns false if the request is not a register access
+	 **/
+	static bool decodeAccess(uint32_t type, unsigned *width, bool *write);
+	/** Receive and execute the operations of a batch under a single lock */
+	int handleBatch(const struct instrulink_packet *req);
+	/** Execute the operations of a batch. Must be called with lock held. */
+	void executeBatch(const struct instrulink_packet *ops, struct instrulink_packet *res,
+			  size_t count);
+	/** Receive and execute a block read or write */
+	int handleBlock(const struct instrulink_packet *req);
+	/** Mark interrupt line as pending. Wait-free and safe to call from any thread. */
+	void raiseIRQ(unsigned line);
+	/** Wake up the event loop to deliver pending interrupts */
+	void kickIRQ();
+	/** Send pending lines unless held back by a transaction or the coalescing window */
+	void deliverIRQs();
+	/**
+	 * \brief Deliver interrupts and run timers on an event loop
+	 * \details Must be called on the loop thread or before it starts polling.
+	 * \returns 0 on success or negative on error
+	 **/
+	int attach(EventLoop *loop);
+	/** Remove interrupt and timer handlers from the event loop */
+	void detach();
+	/** Run a private event loop on a thread of its own (container not served by a host) */
+	int startEventThread();
+	void stopEventThread();
+	/** Hold back interrupts until the response to the current request is sent */
+	void beginTransaction();
+	void endTransaction();
+	/** Send an interrupt notification for the given lines */
+	virtual void emitIRQ(uint64_t lines);
+	/** Switch the calling thread to SCHED_FIFO (realtime_set_fifo()) */
+	virtual int setRealTimePriority(int priority);
+	/** Lock the memory of the whole process (realtime_lock_memory()) */
+	virtual int lockMemory(size_t heap);
+	/** Record service time of a request */
+	void recordLatency(uint64_t start);
+	/** Start serving: marks the container as running */
+	int start();
+	/**
+	 * \brief Serve all requests that can be handled without blocking
+	 * \details Called by the host when the main channel is readable. Partial
+	 * requests stay buffered until the rest arrives.
+	 * \returns 0 on success or negative when the connection failed
+	 **/
+	int serve();
+	/** Ask the container to stop serving after the current request */
+	void halt();
+	/** Detach from the event loop and disconnect from the simulator */
+	void stop();
+	/** File descriptor of the main channel or -1 if it can not be polled */
+	int busFd();
+	/** File descriptor of the interrupt channel or -1 if it can not be polled */
+	int irqFd();
+	/** Render all instruments from their snapshots and commit edits (GUI library) */
+	void renderInstruments();
+	/** Print published state of all instruments prefixed with time and container index */
+	void printTelemetry(FILE *out, unsigned index);
 
     private:
 	/** Main lock */
@@ -38,5 +265,85 @@ class InstrumentContainer {
 	/** Flag showing whether we are still active or waiting for threads to finish */
 	bool is_running;
 	/** List of instruments */
-	std::list<IInstrument *> instruments;
+	std::vector<IInstrument *> instruments;
+	/** Events scheduled by instruments in simulated time */
+	TimingWheel wheel;
+	/** Threads advancing instruments in parallel (NULL advances them one by one) */
+	std::unique_ptr<TickPool> pool;
+	/** Instruments to be committed by commitTouched() */
+	struct {
+		std::vector<IInstrument *> list;
+		/** Set once every instrument needs a commit */
+		bool all;
+	} touched;
+	/** Simulated time in nanoseconds granted by the simulator so far */
+	uint64_t time;
+	/** Payload of the block access being served (too large for the stack of a real-time thread) */
+	uint8_t block[INSTRULINK_BLOCK_MAX];
+	/** Operations of the batch being served and their responses (kept off the stack as well) */
+	struct {
+		struct instrulink_packet ops[INSTRULINK_BATCH_MAX];
+		struct instrulink_packet res[INSTRULINK_BATCH_MAX];
+	} batch;
+	/** Status of posted writes since the last fence */
+	struct {
+		/** Number of failed posted writes */
+		uint64_t errors;
+		/** Address of the first failed posted write */
+		uint64_t addr;
+	} posted;
+	/** Interrupt coalescing state */
+	struct {
+		/** Lines raised but not yet sent */
+		uint64_t pending;
+		/** Set while a bus transaction is executed */
+		bool deferred;
+		/** Coalescing window in nanoseconds */
+		uint64_t window;
+		/** Time of the last notification (loop thread only) */
+		uint64_t last;
+		/** eventfd used to wake up the event loop */
+		int event;
+		/** Timer expiring at the end of the coalescing window */
+		int timer;
+		/** Set while the window timer is armed (loop thread only) */
+		bool armed;
+	} irq;
+	/** Periodic callbacks registered with addTimer() */
+	struct Timer {
+		uint64_t period;
+		std::function<void()> cb;
+		/** Id of the loop timer or -1 while detached */
+		int id;
+	};
+	std::vector<Timer> timers;
+	/** Event loop interrupts and timers are attached to */
+	EventLoop *loop;
+	/** Set while attached to loop */
+	bool attached;
+	/** Set while a commit posted by the GUI thread waits for the loop */
+	bool commit_posted;
+	/** Private event loop used by startEventThread() */
+	struct {
+		std::unique_ptr<EventLoop> loop;
+		bool running;
+		pthread_t thread;
+	} events;
+	/** Command line options */
+	struct {
+		/** Run without a window */
+		bool headless;
+		/** Telemetry period in milliseconds (0 disables telemetry) */
+		unsigned telemetry;
+		/** Core the bus thread is pinned to in real-time mode (-1 to not pin) */
+		int rt_cpu;
+		/** SCHED_FIFO priority of the bus thread in real-time mode (0 to not change) */
+		int rt_priority;
+		/** Time to spin for requests before blocking in microseconds */
+		unsigned busy_poll;
+	} options;
+	/** Statistics collected in real-time mode (written by the bus thread only) */
+	LatencyStats stats;
+	/** Address decoder for bus accesses */
+	AddressMap<IInstrument> map;
 };
@@ -0,0 +1,53 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <pthread.h>
+
+#include "InstrumentContainer.h"
+#include "InstrumentHost.h"
+
+#include <imgui.h>
+
+int InstrumentContainer::show()
+{
+	if (this->options.headless) {
+		return run();
+	}
+
+	InstrumentHost host;
+
+	host.setTelemetry(this->options.telemetry);
+	host.addContainer(this);
+	return host.show();
+}
+
+void InstrumentContainer::renderInstruments()
+{
+	// render from snapshots so that the bus thread never waits for a frame
+	for (auto i : this->instruments) {
+		i->refresh();
+		// widgets of instruments of the same kind must not share ids
+		ImGui::PushID(i);
+		i->render();
+		ImGui::PopID();
+	}
+
+	// apply edits right away unless the bus thread is busy
+	if (pthread_mutex_trylock(&this->lock) == 0) {
+		commit();
+		pthread_mutex_unlock(&this->lock);
+	} else if (this->loop && !__atomic_exchange_n(&this->commit_posted, true, __ATOMIC_SEQ_CST)) {
+		// edits queued after its last commit are applied by the event loop
+		this->loop->post([this] {
+			__atomic_store_n(&this->commit_posted, false, __ATOMIC_SEQ_CST);
+			pthread_mutex_lock(&this->lock);
+			commit();
+			pthread_mutex_unlock(&this->lock);
+		});
+	}
+}
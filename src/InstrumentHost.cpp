@@ -0,0 +1,233 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <stdio.h>
+#include <errno.h>
+#include <sys/epoll.h>
+
+#include "InstrumentHost.h"
+
+InstrumentHost::InstrumentHost()
+{
+	this->is_running = false;
+	this->active = 0;
+	this->telemetry = 0;
+}
+
+InstrumentHost::~InstrumentHost()
+{
+}
+
+void *_host_bus_thread(void *data)
+{
+	InstrumentHost *self = (InstrumentHost *)data;
+
+	self->serve();
+	return NULL;
+}
+
+void *_host_container_thread(void *data)
+{
+	struct InstrumentHost::Worker *w = (struct InstrumentHost::Worker *)data;
+	InstrumentHost *host = w->host;
+	InstrumentContainer *c = w->container;
+
+	if (c->isRealTime()) {
+		c->enterRealTime();
+	}
+	_communication_thread(c);
+	host->loop.post([host, c] { host->drop(c); });
+	return NULL;
+}
+
+int InstrumentHost::addContainer(InstrumentContainer *c)
+{
+	if (this->is_running) {
+		return -EBUSY;
+	}
+	this->containers.push_back(c);
+	return 0;
+}
+
+void InstrumentHost::setTelemetry(unsigned ms)
+{
+	this->telemetry = ms;
+}
+
+bool InstrumentHost::isRunning()
+{
+	return __atomic_load_n(&this->is_running, __ATOMIC_ACQUIRE);
+}
+
+void InstrumentHost::drop(InstrumentContainer *c)
+{
+	// both channels may hang up in the same batch of events
+	if (!c->attached) {
+		return;
+	}
+	if (c->busFd() >= 0) {
+		this->loop.remove(c->busFd());
+	}
+	if (c->irqFd() >= 0) {
+		this->loop.remove(c->irqFd());
+	}
+	c->halt();
+	c->detach();
+	__atomic_sub_fetch(&this->active, 1, __ATOMIC_SEQ_CST);
+}
+
+int InstrumentHost::start()
+{
+	if (!this->loop.valid()) {
+		fprintf(stderr, "Error: could not create host event loop\n");
+		return -EIO;
+	}
+
+	__atomic_store_n(&this->is_running, true, __ATOMIC_RELEASE);
+
+	for (auto c : this->containers) {
+		if (c->start() != 0 || c->attach(&this->loop) != 0) {
+			c->halt();
+			continue;
+		}
+		this->active++;
+
+		if (c->irqFd() >= 0) {
+			this->loop.add(c->irqFd(), EPOLLRDHUP, [this, c](uint32_t events) {
+				fprintf(stderr, "Interrupt channel closed by simulator\n");
+				drop(c);
+			});
+		}
+
+		if (c->busFd() >= 0) {
+			this->loop.add(c->busFd(), EPOLLIN, [this, c](uint32_t events) {
+				if (c->serve() != 0 || !c->isRunning()) {
+					drop(c);
+				}
+			});
+			continue;
+		}
+
+		Worker *w = new Worker{ this, c, 0 };
+
+		pthread_create(&w->thread, NULL, _host_container_thread, w);
+		this->workers.push_back(w);
+	}
+
+	// a loop shared by several containers spins as long as the most demanding one asks for
+	unsigned busy_poll = 0;
+
+	for (auto c : this->containers) {
+		if (c->busyPoll() > busy_poll) {
+			busy_poll = c->busyPoll();
+		}
+	}
+	this->loop.setBusyPoll(busy_poll * 1000ULL);
+
+	if (this->telemetry) {
+		int timer = this->loop.addTimer([this] { logTelemetry(); });
+
+		if (timer >= 0) {
+			this->loop.setTimer(timer, this->telemetry * 1000000ULL,
+					    this->telemetry * 1000000ULL);
+		}
+	}
+	return 0;
+}
+
+void InstrumentHost::serve()
+{
+	// one thread serves all polled containers so the first real-time setting wins
+	InstrumentContainer *rt = NULL;
+
+	for (size_t i = 0; i < this->containers.size(); i++) {
+		InstrumentContainer *c = this->containers[i];
+
+		if (!c->isRealTime() || c->busFd() < 0) {
+			continue;
+		}
+		if (!rt) {
+			rt = c;
+		} else if (c->options.rt_cpu != rt->options.rt_cpu ||
+			   c->options.rt_priority != rt->options.rt_priority) {
+			fprintf(stderr,
+				"Warning: real-time settings of container %zu (cpu %d, priority %d) "
+				"are ignored, the shared bus thread uses cpu %d, priority %d\n",
+				i, c->options.rt_cpu, c->options.rt_priority, rt->options.rt_cpu,
+				rt->options.rt_priority);
+		}
+	}
+	if (rt) {
+		rt->enterRealTime();
+	}
+
+	while (isRunning() && __atomic_load_n(&this->active, __ATOMIC_SEQ_CST) > 0) {
+		if (this->loop.poll() < 0) {
+			fprintf(stderr, "Error: host event loop failed (%d)\n", errno);
+			break;
+		}
+	}
+}
+
+void InstrumentHost::halt()
+{
+	__atomic_store_n(&this->is_running, false, __ATOMIC_RELEASE);
+	this->loop.wakeup();
+
+	for (auto c : this->containers) {
+		c->halt();
+	}
+}
+
+void InstrumentHost::stop()
+{
+	halt();
+	for (auto w : this->workers) {
+		pthread_join(w->thread, NULL);
+		delete w;
+	}
+	this->workers.clear();
+	for (auto c : this->containers) {
+		drop(c);
+		c->stop();
+	}
+
+	EventLoop::WaitStats ws = this->loop.waitStats();
+	bool busy_poll = false;
+
+	for (auto c : this->containers) {
+		busy_poll |= c->busyPoll() != 0;
+	}
+	if (busy_poll) {
+		printf("Event loop: %llu waits satisfied while polling, %llu blocked\n",
+		       (unsigned long long)ws.polled, (unsigned long long)ws.blocked);
+	}
+}
+
+void InstrumentHost::logTelemetry()
+{
+	unsigned c = 0;
+
+	for (auto container : this->containers) {
+		container->printTelemetry(stdout, c++);
+	}
+	fflush(stdout);
+}
+
+int InstrumentHost::run()
+{
+	if (start() != 0) {
+		return -1;
+	}
+
+	// everything is served from the calling thread
+	serve();
+
+	stop();
+	return 0;
+}
@@ -0,0 +1,81 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include "InstrumentContainer.h"
+#include "EventLoop.h"
+
+#include <pthread.h>
+#include <vector>
+
+void *_host_bus_thread(void *data);
+void *_host_container_thread(void *data);
+
+/**
+ * \brief Serves many instrument containers from one process
+ * \details
+ *		Every container has its own instrulink connection. Main channels,
+ *		interrupt channels, interrupt wakeups, instrument timers and wakeups
+ *		from the GUI of all connections are handled by one event loop so a
+ *		single thread serves every container. Connections that can not be
+ *		polled (shared memory) get a thread of their own for the bus. The GUI
+ *		library renders all containers in one window.
+ **/
+class InstrumentHost {
+    public:
+	InstrumentHost();
+	~InstrumentHost();
+	/**
+	 * \brief Serve a container that is already connected to the simulator
+	 * \param c container to serve (must outlive the host)
+	 * \returns 0 on success or negative on error
+	 **/
+	int addContainer(InstrumentContainer *c);
+	/** Print telemetry of all instruments every ms milliseconds (0 disables it) */
+	void setTelemetry(unsigned ms);
+	/** Serve all containers from the calling thread until they have all disconnected */
+	int run();
+	/** Render all containers in one window while a bus thread serves them (GUI library) */
+	int show();
+	friend void *_host_bus_thread(void *data);
+	friend void *_host_container_thread(void *data);
+
+    protected:
+	/** Start serving all containers */
+	int start();
+	/** Run the event loop until all containers have disconnected or halt() is called */
+	void serve();
+	/** Make serve() and all container threads return (any thread) */
+	void halt();
+	/** Wait for container threads and disconnect all containers. Call after serve() returned. */
+	void stop();
+	/** Stop serving a container that has disconnected (loop thread) */
+	void drop(InstrumentContainer *c);
+	void logTelemetry();
+	bool isRunning();
+
+    private:
+	/** Event loop serving all containers */
+	EventLoop loop;
+	/** Flag showing whether we are still active or waiting for threads to finish */
+	bool is_running;
+	/** Number of containers still connected */
+	unsigned active;
+	/** Telemetry period in milliseconds */
+	unsigned telemetry;
+	/** Containers served by this host */
+	std::vector<InstrumentContainer *> containers;
+	/** Thread serving a container that can not be polled */
+	struct Worker {
+		InstrumentHost *host;
+		InstrumentContainer *container;
+		pthread_t thread;
+	};
+	std::vector<Worker *> workers;
+};
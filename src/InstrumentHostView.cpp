@@ -0,0 +1,139 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <stdio.h>
+#include <pthread.h>
+
+#include "InstrumentHost.h"
+
+#include <imgui.h>
+#include <imgui_impl_sdl.h>
+#include <imgui_impl_opengl3.h>
+#include <implot.h>
+
+#include <SDL.h>
+#include <SDL_opengl.h>
+
+int InstrumentHost::show()
+{
+	if (SDL_Init(SDL_INIT_VIDEO | SDL_INIT_TIMER | SDL_INIT_GAMECONTROLLER) != 0) {
+		printf("Error: %s\n", SDL_GetError());
+		return -1;
+	}
+
+	// GL 3.0 + GLSL 130
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_FLAGS, 0);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_PROFILE_MASK, SDL_GL_CONTEXT_PROFILE_CORE);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MAJOR_VERSION, 3);
+	SDL_GL_SetAttribute(SDL_GL_CONTEXT_MINOR_VERSION, 0);
+
+	// Create window with graphics context
+	SDL_GL_SetAttribute(SDL_GL_DOUBLEBUFFER, 1);
+	SDL_GL_SetAttribute(SDL_GL_DEPTH_SIZE, 24);
+	SDL_GL_SetAttribute(SDL_GL_STENCIL_SIZE, 8);
+
+	SDL_WindowFlags window_flags = (SDL_WindowFlags)(SDL_WINDOW_OPENGL | SDL_WINDOW_RESIZABLE |
+							 SDL_WINDOW_ALLOW_HIGHDPI);
+	SDL_Window *window = SDL_CreateWindow("Controller example", SDL_WINDOWPOS_CENTERED,
+					      SDL_WINDOWPOS_CENTERED, 1280, 720, window_flags);
+	SDL_GLContext gl_context = SDL_GL_CreateContext(window);
+	SDL_GL_MakeCurrent(window, gl_context);
+	SDL_GL_SetSwapInterval(1); // Enable vsync
+
+	// Setup Dear ImGui context
+	IMGUI_CHECKVERSION();
+	ImGui::CreateContext();
+	ImPlot::CreateContext();
+	ImGuiIO &io = ImGui::GetIO();
+	(void)io;
+
+	// Setup Dear ImGui style
+	ImGui::StyleColorsDark();
+
+	// Setup Platform/Renderer backends
+	ImGui_ImplSDL2_InitForOpenGL(window, gl_context);
+	ImGui_ImplOpenGL3_Init("#version 130");
+	ImVec4 clear_color = ImVec4(0.45f, 0.55f, 0.60f, 1.00f);
+
+	pthread_t thread;
+	bool serving = start() == 0;
+
+	// the event loop runs on a thread of its own so the frame rate never limits the bus
+	if (serving) {
+		pthread_create(&thread, NULL, _host_bus_thread, this);
+	}
+
+	while (serving && isRunning() && __atomic_load_n(&this->active, __ATOMIC_SEQ_CST) > 0) {
+		SDL_Event event;
+		while (SDL_PollEvent(&event)) {
+			ImGui_ImplSDL2_ProcessEvent(&event);
+			if (event.type == SDL_QUIT) {
+				__atomic_store_n(&this->is_running, false, __ATOMIC_RELEASE);
+			}
+			if (event.type == SDL_WINDOWEVENT &&
+			    event.window.event == SDL_WINDOWEVENT_CLOSE &&
+			    event.window.windowID == SDL_GetWindowID(window)) {
+				__atomic_store_n(&this->is_running, false, __ATOMIC_RELEASE);
+			}
+		}
+
+		// Start the Dear ImGui frame
+		ImGui_ImplOpenGL3_NewFrame();
+		ImGui_ImplSDL2_NewFrame();
+		ImGui::NewFrame();
+
+		ImGui::SetNextWindowPos(ImVec2(0.0, 0.0));
+		ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
+		ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+
+		// instruments draw into this window, each container in a section of its own
+		ImGui::Begin("Memory view", NULL, ImGuiWindowFlags_NoDecoration);
+
+		// every connection gets a section of its own when serving more than one simulator
+		for (size_t c = 0; c < this->containers.size(); c++) {
+			char label[32];
+
+			snprintf(label, sizeof(label), "Instrument %zu", c);
+			ImGui::PushID((int)c);
+			if (this->containers.size() == 1 ||
+			    ImGui::CollapsingHeader(label, ImGuiTreeNodeFlags_DefaultOpen)) {
+				this->containers[c]->renderInstruments();
+			}
+			ImGui::PopID();
+		}
+
+		ImGui::End();
+		ImGui::PopStyleVar(1);
+
+		// Rendering
+		ImGui::Render();
+		glViewport(0, 0, (int)io.DisplaySize.x, (int)io.DisplaySize.y);
+		glClearColor(clear_color.x * clear_color.w, clear_color.y * clear_color.w,
+			     clear_color.z * clear_color.w, clear_color.w);
+		glClear(GL_COLOR_BUFFER_BIT);
+		ImGui_ImplOpenGL3_RenderDrawData(ImGui::GetDrawData());
+		SDL_GL_SwapWindow(window);
+	}
+
+	if (serving) {
+		halt();
+		pthread_join(thread, NULL);
+		stop();
+	}
+
+	ImPlot::DestroyContext();
+	ImGui_ImplOpenGL3_Shutdown();
+	ImGui_ImplSDL2_Shutdown();
+	ImGui::DestroyContext();
+
+	SDL_GL_DeleteContext(gl_context);
+	SDL_DestroyWindow(window);
+	SDL_Quit();
+
+	return 0;
+}
@@ -13,17 +13,10 @@
 KeypadInstrument::KeypadInstrument()
 {
 	memset(&this->regs, 0, sizeof(this->regs));
-}
-
-int KeypadInstrument::read32(uint64_t addr, uint64_t *data)
-{
-	if (addr == __builtin_offsetof(struct keypad_instrument, keys_changed)) {
-		BaseInstrument::read<uint32_t>(addr, data);
-		// reading this register resets it
-		this->regs.keys_changed = 0;
-		return 0;
-	}
-	return BaseInstrument::read<uint32_t>(addr, data);
+	this->buttons = 0;
+	defineRegister(&this->regs.keys, REG_RO | REG_VOLATILE | REG_PURE);
+	// reading the changed keys resets them
+	defineRegister(&this->regs.keys_changed, REG_RC | REG_VOLATILE);
 }
 
 int KeypadInstrument::setKeyState(unsigned key, bool state)
@@ -39,38 +32,3 @@ int KeypadInstrument::setKeyState(unsigned key, bool state)
 	}
 	return 0;
 }
-
-void KeypadInstrument::render()
-{
-	ImGui::SetNextWindowPos(ImVec2(0.0, 0.0));
-	ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
-	ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
-
-	// Instrument render begin
-	ImGui::Begin("Keypad", NULL,
-		     ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration);
-
-	uint32_t prev_keys_changed = this->regs.keys_changed;
-
-	for (unsigned int c = 1; c < 10; c++) {
-		char str[16];
-		snprintf(str, sizeof(str), "%d", c);
-
-		if (ImGui::Button(str, ImVec2(40, 40))) {
-			this->setKeyState(c, true);
-		} else {
-			this->setKeyState(c, false);
-		}
-
-		if (c != 0 && (c % 3) != 0) {
-			ImGui::SameLine();
-		}
-	}
-
-	if (this->regs.keys_changed != prev_keys_changed) {
-		notifyIRQ();
-	}
-
-	ImGui::End();
-	ImGui::PopStyleVar(1);
-}
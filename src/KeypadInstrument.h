@@ -6,13 +6,17 @@
  * Training: https://swedishembedded.com/tag/training
  **/
 
+#pragma once
+
 #include "instruments/keypad.h"
 #include "BaseInstrument.h"
 
 class KeypadInstrument : public BaseInstrument<struct keypad_instrument> {
     public:
 	KeypadInstrument();
-	void render() override;
-	int read32(uint64_t addr, uint64_t *value) override;
 	int setKeyState(unsigned key, bool state);
+
+    protected:
+	/** Button state last requested by render() */
+	uint32_t buttons;
 };
@@ -0,0 +1,42 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include "KeypadInstrumentView.h"
+
+#include <cstdio>
+
+void KeypadInstrumentView::render()
+{
+	ImGui::BeginGroup();
+
+	for (unsigned int c = 1; c < 10; c++) {
+		char str[16];
+		snprintf(str, sizeof(str), "%d", c);
+
+		bool pressed = ImGui::Button(str, ImVec2(40, 40));
+
+		// the view lags behind until the edit is committed
+		if (pressed != !!(this->buttons & (1 << c))) {
+			this->buttons ^= (1 << c);
+			edit([this, c, pressed] {
+				uint32_t prev_keys_changed = this->regs.keys_changed;
+
+				this->setKeyState(c, pressed);
+				if (this->regs.keys_changed != prev_keys_changed) {
+					notifyIRQ();
+				}
+			});
+		}
+
+		if (c != 0 && (c % 3) != 0) {
+			ImGui::SameLine();
+		}
+	}
+
+	ImGui::EndGroup();
+}
@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include "KeypadInstrument.h"
+
+#include <imgui.h>
+
+/** ImGui view of the keypad instrument */
+class KeypadInstrumentView : public KeypadInstrument {
+    public:
+	using KeypadInstrument::KeypadInstrument;
+	void render() override;
+};
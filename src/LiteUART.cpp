@@ -11,11 +11,15 @@
 #define LITEUART_REG_TX_EMPTY 0x818
 #define LITEUART_REG_RX_FULL 0x81c
 
+/** sim_quiet while nothing at all is running in the core */
+#define LITEUART_QUIET_IDLE 0xffffffffu
+
 LiteUART::LiteUART() : WishboneSlave<VLiteUART>(new VLiteUART())
 {
 	this->debug = 0;
 	this->freq = 100000000;
 	this->baud = 115200;
+	this->setClockFrequency(this->freq);
 }
 
 LiteUART::~LiteUART()
@@ -37,8 +41,37 @@ int LiteUART::write32(uint64_t addr, uint64_t data)
 	return WishboneSlave<VLiteUART>::write32(addr, data);
 }
 
+uint64_t LiteUART::fastForward(uint64_t cycles)
+{
+	// settle the model on inputs changed since the last clock edge
+	this->dev->eval();
+
+	uint32_t quiet = this->dev->sim_quiet;
+
+	if (quiet == LITEUART_QUIET_IDLE) {
+		return cycles;
+	}
+
+	// only the baud rate accumulator runs, a single edge stands in for all of
+	// its cycles before the one in which it carries
+	uint64_t n = std::min<uint64_t>(cycles, quiet);
+
+	if (n) {
+		this->dev->sim_skip = n;
+		clockEdge();
+		this->dev->sim_skip = 0;
+	}
+	return n;
+}
+
+bool LiteUART::irqLine()
+{
+	return this->dev->irq_uart0;
+}
+
 bool LiteUART::txo()
 {
+	catchUp();
 	return this->dev->serial_tx;
 }
 
@@ -5,6 +5,9 @@
 #include "VLiteUART.h"
 #include "bus/WishboneSlave.h"
 
+/** Size of the CSR window decoded by the LiteUART wishbone interface */
+#define LITEUART_REG_SIZE 0x1000
+
 class VLiteUART;
 
 /**
@@ -20,6 +23,15 @@ class LiteUART : public WishboneSlave<VLiteUART> {
 	bool txo();
 	int rx(uint8_t *data);
 
+    protected:
+	/**
+	 * Skips the cycles the core reports as quiet on its sim_quiet output:
+	 * all of them while it is idle, or those before the next baud rate tick
+	 * in one sim_skip edge while a byte is being sent.
+	 **/
+	uint64_t fastForward(uint64_t cycles) override;
+	bool irqLine() override;
+
     private:
 	/** \brief write 32 bit regsiter **/
 	virtual int write32(uint64_t addr, uint64_t data) override;
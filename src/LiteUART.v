@@ -22,7 +22,9 @@ module liteuart(
 	input [2:0] wb_cti,
 	input [1:0] wb_bte,
 	output wb_err,
-	output irq_uart0
+	output irq_uart0,
+	input [31:0] sim_skip,
+	output [31:0] sim_quiet
 );
 
 wire sys_clk;
@@ -572,6 +574,17 @@ always @(*) begin
 end
 assign main_rx = builder_regs1;
 
+// Simulation only (not generated): sim_quiet is the number of upcoming cycles
+// in which nothing but the transmit baud rate accumulator changes, all ones
+// while the whole core is idle. A clock edge with sim_skip set advances that
+// accumulator by sim_skip cycles at once.
+wire sim_bus_idle = ((((~builder_state) & (~wb_ack)) & (~wb_rst)) & (~main_int_rst));
+wire sim_rx_idle = ((((((((((serial_rx & builder_regs0) & builder_regs1) & main_rx_r) & (~main_rx_busy)) & (~main_source_valid)) & (~main_uart_clk_rxen)) & (main_phase_accumulator_rx == 32'd2147483648)) & (main_rx_fifo_level0 == 1'd0)) & (~main_rx_fifo_readable)) & main_rx_old_trigger);
+wire sim_tx_settled = (((~main_sink_ready) & ((main_tx_fifo_level0 == 1'd0) | main_tx_fifo_readable)) & (main_tx_old_trigger == (main_tx_fifo_level0 == 5'd16)));
+wire sim_tx_idle = ((((~main_tx_busy) & (~main_tx_fifo_readable)) & (~main_uart_clk_txen)) & (main_phase_accumulator_tx == 1'd0));
+wire [32:0] sim_tx_wait = ((main_storage == 1'd0) ? 33'd4294967294 : ((((33'd4294967296 - main_phase_accumulator_tx) + main_storage) - 1'd1) / main_storage) - 1'd1);
+assign sim_quiet = ((sim_bus_idle & sim_rx_idle & sim_tx_settled) ? (sim_tx_idle ? 32'd4294967295 : ((main_tx_busy & (~main_uart_clk_txen)) ? ((sim_tx_wait > 33'd4294967294) ? 32'd4294967294 : sim_tx_wait[31:0]) : 1'd0)) : 1'd0);
+
 always @(posedge por_clk) begin
 	main_int_rst <= wb_rst;
 end
@@ -601,7 +614,7 @@ always @(posedge sys_clk) begin
 		end
 	end
 	if (main_tx_busy) begin
-		{main_uart_clk_txen, main_phase_accumulator_tx} <= (main_phase_accumulator_tx + main_storage);
+		{main_uart_clk_txen, main_phase_accumulator_tx} <= (main_phase_accumulator_tx + ((sim_skip == 1'd0) ? main_storage : (sim_skip * main_storage)));
 	end else begin
 		{main_uart_clk_txen, main_phase_accumulator_tx} <= 1'd0;
 	end
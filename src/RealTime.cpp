@@ -0,0 +1,73 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <errno.h>
+#include <malloc.h>
+#include <pthread.h>
+#include <sched.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "RealTime.h"
+
+int realtime_pin(int cpu)
+{
+	cpu_set_t set;
+
+	if (cpu < 0 || cpu >= CPU_SETSIZE) {
+		return -EINVAL;
+	}
+	CPU_ZERO(&set);
+	CPU_SET(cpu, &set);
+	// returns the error instead of setting errno
+	return -pthread_setaffinity_np(pthread_self(), sizeof(set), &set);
+}
+
+int realtime_set_fifo(int priority)
+{
+	struct sched_param param;
+
+	memset(&param, 0, sizeof(param));
+	param.sched_priority = priority;
+	return -pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+}
+
+int realtime_lock_memory(size_t heap)
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+		return -errno;
+	}
+
+	// keep freed memory in the process so it stays locked and faulted in
+	mallopt(M_TRIM_THRESHOLD, -1);
+	mallopt(M_MMAP_MAX, 0);
+
+	char *p = (char *)malloc(heap);
+
+	if (p) {
+		long page = sysconf(_SC_PAGESIZE);
+
+		for (size_t c = 0; c < heap; c += page) {
+			((volatile char *)p)[c] = 0;
+		}
+		free(p);
+	}
+	return 0;
+}
+
+void realtime_prefault_stack(size_t size)
+{
+	volatile char *stack = (volatile char *)alloca(size);
+	long page = sysconf(_SC_PAGESIZE);
+
+	for (size_t c = 0; c < size; c += page) {
+		stack[c] = 0;
+	}
+}
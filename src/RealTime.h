@@ -0,0 +1,51 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ *
+ * Helpers for running the bus thread with bounded latency. Every step can
+ * fail without privileges (CAP_SYS_NICE, CAP_IPC_LOCK or large enough
+ * RLIMIT_RTPRIO and RLIMIT_MEMLOCK) in which case the caller is expected to
+ * carry on with normal scheduling.
+ **/
+
+#pragma once
+
+#include <stddef.h>
+
+/** Thread was pinned to the requested core */
+#define REALTIME_PINNED (1 << 0)
+/** Thread runs with SCHED_FIFO */
+#define REALTIME_FIFO (1 << 1)
+/** Process memory is locked */
+#define REALTIME_LOCKED (1 << 2)
+
+/** Stack pre-faulted by realtime_prefault_stack() */
+#define REALTIME_STACK_SIZE (256 * 1024)
+/** Heap pre-faulted and kept by realtime_lock_memory() */
+#define REALTIME_HEAP_SIZE (4 * 1024 * 1024)
+
+/**
+ * \brief Pin the calling thread to a core
+ * \returns 0 on success or negative errno
+ **/
+int realtime_pin(int cpu);
+
+/**
+ * \brief Switch the calling thread to SCHED_FIFO
+ * \returns 0 on success or negative errno
+ **/
+int realtime_set_fifo(int priority);
+
+/**
+ * \brief Lock all current and future memory of the process
+ * \details Also stops malloc from returning memory to the kernel and
+ * pre-faults heap so that allocations on the bus path do not page fault.
+ * \returns 0 on success or negative errno
+ **/
+int realtime_lock_memory(size_t heap);
+
+/** Touch size bytes of the calling thread's stack */
+void realtime_prefault_stack(size_t size);
@@ -0,0 +1,80 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/**
+ * \brief Seqlock protected copy of a plain data structure
+ * \details
+ *		The writer publishes a new copy by making the sequence counter odd,
+ *		copying the data and making it even again. Readers never block the
+ *		writer: they copy the data and retry if the counter was odd or has
+ *		changed while they were copying. Writers must be serialized by the
+ *		caller.
+ **/
+template <typename T> class Snapshot {
+    public:
+	Snapshot()
+	{
+		memset(&data, 0, sizeof(data));
+	}
+
+	/** Publish a new copy (writer) */
+	void publish(const T &value)
+	{
+		uint32_t seq = __atomic_load_n(&this->seq, __ATOMIC_RELAXED);
+
+		__atomic_store_n(&this->seq, seq + 1, __ATOMIC_RELAXED);
+		__atomic_thread_fence(__ATOMIC_RELEASE);
+		memcpy(&data, &value, sizeof(T));
+		__atomic_store_n(&this->seq, seq + 2, __ATOMIC_RELEASE);
+	}
+
+	/** Read a consistent copy (reader) */
+	void read(T *value) const
+	{
+		for (;;) {
+			uint32_t seq = __atomic_load_n(&this->seq, __ATOMIC_ACQUIRE);
+
+			if (seq & 1) {
+				// writer is copying
+				continue;
+			}
+			memcpy(value, &data, sizeof(T));
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&this->seq, __ATOMIC_RELAXED) == seq) {
+				return;
+			}
+		}
+	}
+
+	/** Read a consistent copy of len bytes at offset into the data (reader) */
+	void read(size_t offset, void *value, size_t len) const
+	{
+		for (;;) {
+			uint32_t seq = __atomic_load_n(&this->seq, __ATOMIC_ACQUIRE);
+
+			if (seq & 1) {
+				continue;
+			}
+			memcpy(value, (const uint8_t *)&data + offset, len);
+			__atomic_thread_fence(__ATOMIC_ACQUIRE);
+			if (__atomic_load_n(&this->seq, __ATOMIC_RELAXED) == seq) {
+				return;
+			}
+		}
+	}
+
+    private:
+	uint32_t seq = 0;
+	T data;
+};
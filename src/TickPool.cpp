@@ -0,0 +1,150 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include <stdio.h>
+#include <string.h>
+
+#include "TickPool.h"
+
+TickPool::TickPool(unsigned threads)
+{
+	this->fn = NULL;
+	this->generation = 0;
+	this->busy = 0;
+	this->exit = false;
+	this->slices.reset(new Slice[threads + 1]);
+	for (unsigned c = 0; c <= threads; c++) {
+		this->slices[c].next = 0;
+		this->slices[c].end = 0;
+	}
+	pthread_mutex_init(&this->lock, NULL);
+	pthread_cond_init(&this->start, NULL);
+	pthread_cond_init(&this->done, NULL);
+
+	// size the vector first so that the addresses handed to the threads stay valid
+	this->workers.resize(threads);
+	for (unsigned c = 0; c < threads; c++) {
+		Worker *w = &this->workers[c];
+
+		w->pool = this;
+		w->index = c + 1;
+
+		int r = pthread_create(&w->thread, NULL, _tick_pool_thread, w);
+
+		if (r != 0) {
+			// the pool works with whatever threads did start (shrinking keeps their addresses)
+			fprintf(stderr, "Warning: started only %u of %u tick threads (%s)\n", c,
+				threads, strerror(r));
+			this->workers.resize(c);
+			break;
+		}
+	}
+}
+
+TickPool::~TickPool()
+{
+	pthread_mutex_lock(&this->lock);
+	this->exit = true;
+	pthread_cond_broadcast(&this->start);
+	pthread_mutex_unlock(&this->lock);
+
+	for (auto &w : this->workers) {
+		pthread_join(w.thread, NULL);
+	}
+	pthread_cond_destroy(&this->done);
+	pthread_cond_destroy(&this->start);
+	pthread_mutex_destroy(&this->lock);
+}
+
+void *_tick_pool_thread(void *data)
+{
+	TickPool::Worker *w = (TickPool::Worker *)data;
+
+	w->pool->serve(w->index);
+	return NULL;
+}
+
+unsigned TickPool::size() const
+{
+	return this->workers.size() + 1;
+}
+
+void TickPool::work(unsigned self)
+{
+	unsigned n = size();
+
+	for (unsigned c = 0; c < n; c++) {
+		Slice *s = &this->slices[(self + c) % n];
+
+		for (;;) {
+			size_t task = __atomic_fetch_add(&s->next, 1, __ATOMIC_RELAXED);
+
+			if (task >= s->end) {
+				break;
+			}
+			(*this->fn)(task);
+		}
+	}
+}
+
+void TickPool::serve(unsigned self)
+{
+	uint64_t generation = 0;
+
+	pthread_mutex_lock(&this->lock);
+	for (;;) {
+		while (this->generation == generation && !this->exit) {
+			pthread_cond_wait(&this->start, &this->lock);
+		}
+		if (this->exit) {
+			break;
+		}
+		generation = this->generation;
+		pthread_mutex_unlock(&this->lock);
+
+		work(self);
+
+		pthread_mutex_lock(&this->lock);
+		if (--this->busy == 0) {
+			pthread_cond_signal(&this->done);
+		}
+	}
+	pthread_mutex_unlock(&this->lock);
+}
+
+void TickPool::run(size_t count, const std::function<void(size_t)> &fn)
+{
+	if (this->workers.empty() || count < 2) {
+		for (size_t c = 0; c < count; c++) {
+			fn(c);
+		}
+		return;
+	}
+
+	unsigned n = size();
+
+	pthread_mutex_lock(&this->lock);
+	for (unsigned c = 0; c < n; c++) {
+		this->slices[c].next = count * c / n;
+		this->slices[c].end = count * (c + 1) / n;
+	}
+	this->fn = &fn;
+	this->busy = this->workers.size();
+	this->generation++;
+	pthread_cond_broadcast(&this->start);
+	pthread_mutex_unlock(&this->lock);
+
+	work(0);
+
+	// barrier: fn must stay valid until every worker is done with it
+	pthread_mutex_lock(&this->lock);
+	while (this->busy) {
+		pthread_cond_wait(&this->done, &this->lock);
+	}
+	pthread_mutex_unlock(&this->lock);
+}
@@ -0,0 +1,78 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include <pthread.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include <functional>
+#include <memory>
+#include <vector>
+
+void *_tick_pool_thread(void *data);
+
+/**
+ * \brief Thread pool running one batch of independent tasks at a time
+ * \details
+ *		The tasks of a batch are split into one contiguous slice per thread.
+ *		A thread first takes tasks from its own slice and then steals from
+ *		the slices of the others, so a few slow tasks do not leave the rest
+ *		of the pool idle. The calling thread takes part in the batch and
+ *		run() returns only once every task has finished, which makes it the
+ *		barrier at the end of each quantum.
+ **/
+class TickPool {
+    public:
+	/**
+	 * \param threads number of threads started in addition to the caller
+	 * (fewer if the system refuses to create all of them, see size())
+	 **/
+	explicit TickPool(unsigned threads);
+	~TickPool();
+	/** Number of threads working on a batch including the caller */
+	unsigned size() const;
+	/**
+	 * \brief Run fn(0) ... fn(count - 1) in parallel and wait for all of them
+	 * \details Must only be called from one thread at a time.
+	 **/
+	void run(size_t count, const std::function<void(size_t)> &fn);
+	friend void *_tick_pool_thread(void *data);
+
+    private:
+	/** Tasks handed to one thread, padded so threads do not share cache lines */
+	struct Slice {
+		/** Next task to take (may run past end) */
+		size_t next __attribute__((aligned(64)));
+		size_t end;
+	};
+	struct Worker {
+		TickPool *pool;
+		unsigned index;
+		pthread_t thread;
+	};
+	/** Take tasks from slice self and then from all other slices */
+	void work(unsigned self);
+	void serve(unsigned self);
+
+	std::vector<Worker> workers;
+	std::unique_ptr<Slice[]> slices;
+	/** Task function of the current batch */
+	const std::function<void(size_t)> *fn;
+	pthread_mutex_t lock;
+	/** Signalled when a new batch is started */
+	pthread_cond_t start;
+	/** Signalled when the last worker has finished the batch */
+	pthread_cond_t done;
+	/** Incremented for every batch */
+	uint64_t generation;
+	/** Workers still working on the current batch */
+	unsigned busy;
+	bool exit;
+};
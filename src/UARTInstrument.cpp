@@ -18,28 +18,34 @@ UARTInstrument::UARTInstrument(std::unique_ptr<IPeripheral> uart)
 	this->uart->write32(0, 0xaa);
 }
 
-int UARTInstrument::write32(uint64_t addr, uint64_t data)
+void UARTInstrument::advance(uint64_t ns)
 {
-	return this->uart->write32(addr, data);
+	this->uart->advance(ns);
 }
 
-void UARTInstrument::onIRQ()
+void UARTInstrument::endQuantum()
 {
-	// Currently not used
+	this->uart->endQuantum();
 }
 
-void UARTInstrument::render()
+int UARTInstrument::access(uint64_t addr, unsigned width, bool write, uint64_t *data)
 {
-	ImGui::SetNextWindowPos(ImVec2(0.0, 0.0));
-	ImGui::SetNextWindowSize(ImGui::GetIO().DisplaySize);
-	ImGui::PushStyleVar(ImGuiStyleVar_WindowRounding, 0.0f);
+	return this->uart->access(addr, width, write, data);
+}
 
-	// Instrument render begin
-	ImGui::Begin("UART", NULL,
-		     ImGuiWindowFlags_AlwaysAutoResize | ImGuiWindowFlags_NoDecoration);
+int UARTInstrument::writeBlock(uint64_t addr, const uint8_t *data, size_t len)
+{
+	return this->uart->writeBlock(addr, data, len);
+}
 
-	ImGui::Text("UART visualization is currently not implemented\n");
+int UARTInstrument::readBlock(uint64_t addr, uint8_t *data, size_t len)
+{
+	return this->uart->readBlock(addr, data, len);
+}
 
-	ImGui::End();
-	ImGui::PopStyleVar(1);
+void UARTInstrument::onIRQ()
+{
+	if (this->notifyIRQ) {
+		this->notifyIRQ();
+	}
 }
@@ -6,6 +6,8 @@
  * Training: https://swedishembedded.com/tag/training
  **/
 
+#pragma once
+
 #include "instruments/uart.h"
 #include "IUARTInstrument.h"
 #include "IUARTPeripheral.h"
@@ -22,8 +24,11 @@
 class UARTInstrument : public BaseInstrument<struct uart_instrument> {
     public:
 	UARTInstrument(std::unique_ptr<IPeripheral> uart);
-	void render() override;
-	int write32(uint64_t addr, uint64_t value) override;
+	void advance(uint64_t ns) override;
+	void endQuantum() override;
+	int access(uint64_t addr, unsigned width, bool write, uint64_t *data) override;
+	int writeBlock(uint64_t addr, const uint8_t *data, size_t len) override;
+	int readBlock(uint64_t addr, uint8_t *data, size_t len) override;
 	void onIRQ();
 
     private:
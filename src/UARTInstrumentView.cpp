@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#include "UARTInstrumentView.h"
+
+#include <cstdio>
+
+void UARTInstrumentView::render()
+{
+	ImGui::BeginGroup();
+
+	ImGui::Text("UART visualization is currently not implemented\n");
+
+	ImGui::EndGroup();
+}
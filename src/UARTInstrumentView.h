@@ -0,0 +1,20 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ **/
+
+#pragma once
+
+#include "UARTInstrument.h"
+
+#include <imgui.h>
+
+/** ImGui view of the UART instrument */
+class UARTInstrumentView : public UARTInstrument {
+    public:
+	using UARTInstrument::UARTInstrument;
+	void render() override;
+};
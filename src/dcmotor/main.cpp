@@ -24,14 +24,14 @@
  **/
 
 #include "InstrumentContainer.h"
-#include "DCMotorInstrument.h"
+#include "DCMotorInstrumentView.h"
 
 int main(int argc, char **argv)
 {
 	InstrumentContainer window;
-	DCMotorInstrument motor;
+	DCMotorInstrumentView motor;
 	window.init(argc, argv);
-	window.addInstrument(&motor);
+	window.addInstrument(&motor, 0, sizeof(struct dcmotor_instrument));
 	window.show();
 	return 0;
 }
@@ -0,0 +1,128 @@
+// SPDX-License-Identifier: Apache-2.0
+/**
+ * Copyright 2022 Martin Schröder <info@swedishembedded.com>
+ *
+ * Consulting: https://swedishembedded.com/go
+ * Training: https://swedishembedded.com/tag/training
+ *
+ * This example serves many simulated peripherals from one process. Every
+ * peripheral gets its own instrulink connection (the same arguments that the
+ * standalone instrument binaries take) and the connections are separated by
+ * a comma:
+ *
+ *   instrument-host keypad 4000 4001 127.0.0.1 , dcmotor unix /tmp/m /tmp/i
+ *
+ * All connections are served by a single bus thread and all instruments are
+ * rendered in one window.
+ **/
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#include <memory>
+#include <vector>
+
+#include "InstrumentHost.h"
+#include "KeypadInstrumentView.h"
+#include "DCMotorInstrumentView.h"
+#include "UARTInstrumentView.h"
+#include "LiteUART.h"
+
+static void usage(const char *prog)
+{
+	printf("Usage: %s [options] <instrument> <connection> [, <instrument> <connection>]...\n",
+	       prog);
+	printf("Instruments: keypad, dcmotor, liteuart\n");
+	printf("Connection: <mainPort> <irqPort> <address> | unix <mainPath> <irqPath> | shm <name>\n");
+	printf("Options:\n");
+	printf("  --headless        serve instrulink without opening a window\n");
+	printf("  --telemetry <ms>  print instrument registers every <ms> milliseconds\n");
+}
+
+static IInstrument *create_instrument(const char *type, uint64_t *size)
+{
+	if (strcmp(type, "keypad") == 0) {
+		*size = sizeof(struct keypad_instrument);
+		return new KeypadInstrumentView();
+	} else if (strcmp(type, "dcmotor") == 0) {
+		*size = sizeof(struct dcmotor_instrument);
+		return new DCMotorInstrumentView();
+	} else if (strcmp(type, "liteuart") == 0) {
+		*size = LITEUART_REG_SIZE;
+		return new UARTInstrumentView(std::unique_ptr<IPeripheral>(new LiteUART()));
+	}
+	return NULL;
+}
+
+int main(int argc, char **argv)
+{
+	const char *prog = argv[0];
+	bool headless = false;
+	unsigned telemetry = 0;
+
+	while (argc > 1 && strncmp(argv[1], "--", 2) == 0) {
+		if (strcmp(argv[1], "--headless") == 0) {
+			headless = true;
+			argv++;
+			argc--;
+		} else if (strcmp(argv[1], "--telemetry") == 0 && argc > 2) {
+			telemetry = atoi(argv[2]);
+			argv += 2;
+			argc -= 2;
+		} else {
+			usage(prog);
+			return 1;
+		}
+	}
+
+	std::vector<std::unique_ptr<InstrumentContainer> > containers;
+	std::vector<std::unique_ptr<IInstrument> > instruments;
+	InstrumentHost host;
+
+	host.setTelemetry(telemetry);
+
+	int i = 1;
+
+	while (i < argc) {
+		// connection arguments run up to the next separator
+		int end = i + 1;
+
+		while (end < argc && strcmp(argv[end], ",") != 0) {
+			end++;
+		}
+
+		uint64_t size;
+		IInstrument *ins = create_instrument(argv[i], &size);
+
+		if (!ins) {
+			usage(prog);
+			return 1;
+		}
+		instruments.emplace_back(ins);
+
+		// init() expects the program name in front of the connection arguments
+		std::vector<char *> args;
+
+		args.push_back((char *)prog);
+		args.insert(args.end(), argv + i + 1, argv + end);
+
+		InstrumentContainer *c = new InstrumentContainer();
+
+		containers.emplace_back(c);
+		if (c->init(args.size(), args.data()) != 0) {
+			return 1;
+		}
+		c->addInstrument(ins, 0, size);
+		host.addContainer(c);
+
+		i = end + 1;
+	}
+
+	if (containers.empty()) {
+		usage(prog);
+		return 1;
+	}
+
+	return headless ? host.run() : host.show();
+}
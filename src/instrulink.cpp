@@ -9,24 +9,536 @@
 #include <stdio.h>
 #include <string.h>
 #include <errno.h>
+#include <time.h>
 #include <sys/socket.h>
+#include <sys/uio.h>
+#include <sys/un.h>
 #include <arpa/inet.h>
 
 #ifdef __linux__
+#include <fcntl.h>
+#include <poll.h>
 #include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <instruments/protocol/shm.h>
 #else
 #include <net/socket.h>
 #endif
 
 #include <instruments/protocol/instrulink.h>
 
+#include "Clock.h"
+
+/** Size of the receive buffer used by socket transports (fits the largest frame) */
+#define INSTRULINK_RX_BUFFER_SIZE (sizeof(struct instrulink_packet) + INSTRULINK_BLOCK_MAX)
+/** Size of the buffer used for coalescing responses on stream sockets */
+#define INSTRULINK_TX_BUFFER_SIZE 4096
+
+/** Operations implemented by each transport */
+struct instrulink_transport {
+	/** Receive exactly len bytes from the main channel */
+	int (*recv)(struct instrulink *self, void *data, size_t len);
+	/** Send a frame made up of iovcnt buffers on the main channel */
+	int (*send)(struct instrulink *self, const struct iovec *iov, int iovcnt);
+	/** Send a frame on the irq channel */
+	int (*send_irq)(struct instrulink *self, const void *data, size_t len);
+	/** Returns true if a complete request can be received without blocking */
+	bool (*pending)(struct instrulink *self);
+	/** Buffer whatever arrived on the main channel without blocking (NULL if not polled) */
+	int (*fill)(struct instrulink *self);
+	/** Send responses held back for the rest of a burst (NULL if none are held) */
+	int (*flush)(struct instrulink *self);
+	/** Make a receive blocked in another thread fail (NULL for transports served by polling) */
+	void (*shutdown)(struct instrulink *self);
+	/** Release transport resources */
+	void (*close)(struct instrulink *self);
+};
+
 struct instrulink {
+	/** Transport used for this connection */
+	const struct instrulink_transport *transport;
 	/** Main socket from simulator to us (req/res) */
 	int mainSocket;
 	/** Special socket from us to simulator (req/res) */
 	int irqSocket;
+	/** Receive buffer holding data not yet handed out */
+	struct {
+		uint8_t data[INSTRULINK_RX_BUFFER_SIZE];
+		size_t len;
+		size_t pos;
+	} rx;
+	/** Responses waiting to be flushed (stream sockets) */
+	struct {
+		uint8_t data[INSTRULINK_TX_BUFFER_SIZE];
+		size_t len;
+	} tx;
+	/** Hybrid wait: spin for ns before blocking on the main channel */
+	struct {
+		uint64_t ns;
+		struct instrulink_wait_stats stats;
+	} busy_poll;
+#ifdef __linux__
+	/** Shared memory segment (shm transport) */
+	struct instrulink_shm *shm;
+#endif
+};
+
+static inline void cpu_relax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+	__builtin_ia32_pause();
+#elif defined(__aarch64__)
+	__asm__ __volatile__("yield");
+#endif
+}
+
+/** Wait until a descriptor is ready for events (POLLIN or POLLOUT) */
+static void wait_fd(int fd, short events)
+{
+	struct pollfd pfd = { .fd = fd, .events = events, .revents = 0 };
+
+	while (poll(&pfd, 1, -1) < 0 && errno == EINTR) {
+	}
+}
+
+/**
+ * Receive a message on the main channel. With busy polling enabled the
+ * channel is polled without blocking for the configured time first so that
+ * a request arriving soon is picked up without a scheduler wakeup.
+ */
+static ssize_t main_recvmsg(struct instrulink *self, struct msghdr *msg)
+{
+	if (self->busy_poll.ns) {
+		uint64_t deadline = monotonic_ns() + self->busy_poll.ns;
+
+		do {
+			ssize_t r = recvmsg(self->mainSocket, msg, MSG_DONTWAIT);
+
+			if (r >= 0 || (errno != EAGAIN && errno != EWOULDBLOCK && errno != EINTR)) {
+				self->busy_poll.stats.polled++;
+				return r;
+			}
+			cpu_relax();
+		} while (monotonic_ns() < deadline);
+	}
+	self->busy_poll.stats.blocked++;
+
+	ssize_t r;
+
+	// the descriptor may be non-blocking when the channel is also polled
+	while ((r = recvmsg(self->mainSocket, msg, 0)) < 0 &&
+	       (errno == EAGAIN || errno == EWOULDBLOCK)) {
+		wait_fd(self->mainSocket, POLLIN);
+	}
+	return r;
+}
+
+static int write_all(int fd, struct iovec *iov, int iovcnt)
+{
+	while (iovcnt > 0) {
+		ssize_t r = writev(fd, iov, iovcnt);
+
+		if (r < 0) {
+			if (errno == EINTR) {
+				continue;
+			} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+				// non-blocking descriptor with a full socket buffer
+				wait_fd(fd, POLLOUT);
+				continue;
+			}
+			return -EIO;
+		}
+
+		// skip over whatever was written and retry with the rest
+		while (iovcnt > 0 && (size_t)r >= iov->iov_len) {
+			r -= iov->iov_len;
+			iov++;
+			iovcnt--;
+		}
+		if (iovcnt > 0) {
+			iov->iov_base = (uint8_t *)iov->iov_base + r;
+			iov->iov_len -= r;
+		}
+	}
+	return 0;
+}
+
+static int stream_flush(struct instrulink *self)
+{
+	if (self->tx.len == 0) {
+		return 0;
+	}
+
+	struct iovec iov = { .iov_base = self->tx.data, .iov_len = self->tx.len };
+
+	self->tx.len = 0;
+	return write_all(self->mainSocket, &iov, 1);
+}
+
+/** Size of the frame started by a request header including what follows it */
+static size_t frame_size(const struct instrulink_packet *hdr)
+{
+	size_t size = sizeof(*hdr);
+
+	// invalid sizes are rejected by the receiver before it reads any further
+	if (hdr->type == MSG_TYPE_BATCH && hdr->value > 0 && hdr->value <= INSTRULINK_BATCH_MAX) {
+		size += hdr->value * sizeof(*hdr);
+	} else if (hdr->type == MSG_TYPE_WRITE_BLOCK && hdr->value <= INSTRULINK_BLOCK_MAX) {
+		size += hdr->value;
+	}
+	return size;
+}
+
+/** Returns true if a complete request (with its operations or payload) is already buffered */
+static bool stream_has_request(struct instrulink *self)
+{
+	size_t n = self->rx.len - self->rx.pos;
+	struct instrulink_packet hdr;
+
+	if (n < sizeof(hdr)) {
+		return false;
+	}
+	memcpy(&hdr, &self->rx.data[self->rx.pos], sizeof(hdr));
+	return n >= frame_size(&hdr);
+}
+
+static int stream_fill(struct instrulink *self)
+{
+	// keep the start of a partial frame and append to it (the largest frame fits the buffer)
+	if (self->rx.pos > 0) {
+		memmove(self->rx.data, &self->rx.data[self->rx.pos], self->rx.len - self->rx.pos);
+		self->rx.len -= self->rx.pos;
+		self->rx.pos = 0;
+	}
+
+	while (self->rx.len < sizeof(self->rx.data)) {
+		ssize_t r = recv(self->mainSocket, &self->rx.data[self->rx.len],
+				 sizeof(self->rx.data) - self->rx.len, MSG_DONTWAIT);
+
+		if (r > 0) {
+			self->rx.len += r;
+		} else if (r == 0) {
+			return -EIO;
+		} else if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			break;
+		} else if (errno != EINTR) {
+			return -EIO;
+		}
+	}
+	return 0;
+}
+
+static int stream_recv(struct instrulink *self, void *data, size_t len)
+{
+	uint8_t *dst = (uint8_t *)data;
+
+	while (len > 0) {
+		if (self->rx.pos == self->rx.len) {
+			// we are about to block so the simulator must have all responses
+			if (stream_flush(self) != 0) {
+				return -EIO;
+			}
+
+			// pull in as much as is available so that following requests
+			// can be handed out without another syscall
+			struct iovec iov = { .iov_base = self->rx.data,
+					     .iov_len = sizeof(self->rx.data) };
+			struct msghdr msg;
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+
+			ssize_t r = main_recvmsg(self, &msg);
+
+			if (r < 0 && errno == EINTR) {
+				continue;
+			} else if (r <= 0) {
+				return -EIO;
+			}
+			self->rx.len = r;
+			self->rx.pos = 0;
+		}
+
+		size_t n = self->rx.len - self->rx.pos;
+
+		if (n > len) {
+			n = len;
+		}
+		memcpy(dst, &self->rx.data[self->rx.pos], n);
+		self->rx.pos += n;
+		dst += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int stream_send(struct instrulink *self, const struct iovec *iov, int iovcnt)
+{
+	size_t len = 0;
+
+	for (int c = 0; c < iovcnt; c++) {
+		len += iov[c].iov_len;
+	}
+
+	if (self->tx.len + len > sizeof(self->tx.data)) {
+		if (stream_flush(self) != 0) {
+			return -EIO;
+		}
+	}
+
+	if (len > sizeof(self->tx.data)) {
+		// too large to coalesce so write it out directly
+		for (int c = 0; c < iovcnt; c++) {
+			struct iovec part = iov[c];
+
+			if (write_all(self->mainSocket, &part, 1) != 0) {
+				return -EIO;
+			}
+		}
+		return 0;
+	}
+
+	for (int c = 0; c < iovcnt; c++) {
+		memcpy(&self->tx.data[self->tx.len], iov[c].iov_base, iov[c].iov_len);
+		self->tx.len += iov[c].iov_len;
+	}
+
+	// hold on to responses while more requests are queued so that they all
+	// go out in one write once the queue has drained
+	if (!stream_has_request(self)) {
+		return stream_flush(self);
+	}
+	return 0;
+}
+
+static int socket_send_irq(struct instrulink *self, const void *data, size_t len)
+{
+	int r = send(self->irqSocket, data, len, 0);
+
+	if (r < 0) {
+		return -EIO;
+	} else if ((size_t)r != len) {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static void socket_close(struct instrulink *self)
+{
+	close(self->mainSocket);
+	close(self->irqSocket);
+}
+
+static void stream_close(struct instrulink *self)
+{
+	stream_flush(self);
+	socket_close(self);
+}
+
+static const struct instrulink_transport stream_transport = {
+	.recv = stream_recv,
+	.send = stream_send,
+	.send_irq = socket_send_irq,
+	.pending = stream_has_request,
+	.fill = stream_fill,
+	.flush = stream_flush,
+	.shutdown = NULL,
+	.close = stream_close,
 };
 
+static int seqpacket_recv(struct instrulink *self, void *data, size_t len)
+{
+	uint8_t *dst = (uint8_t *)data;
+
+	while (len > 0) {
+		if (self->rx.pos == self->rx.len) {
+			struct iovec iov = { .iov_base = self->rx.data,
+					     .iov_len = sizeof(self->rx.data) };
+			struct msghdr msg;
+
+			memset(&msg, 0, sizeof(msg));
+			msg.msg_iov = &iov;
+			msg.msg_iovlen = 1;
+
+			int r = main_recvmsg(self, &msg);
+
+			if (r <= 0) {
+				return -EIO;
+			} else if (msg.msg_flags & MSG_TRUNC) {
+				return -EINVAL;
+			}
+			self->rx.len = r;
+			self->rx.pos = 0;
+		}
+
+		size_t n = self->rx.len - self->rx.pos;
+
+		if (n > len) {
+			n = len;
+		}
+		memcpy(dst, &self->rx.data[self->rx.pos], n);
+		self->rx.pos += n;
+		dst += n;
+		len -= n;
+	}
+	return 0;
+}
+
+static int seqpacket_send(struct instrulink *self, const struct iovec *iov, int iovcnt)
+{
+	struct msghdr msg;
+	size_t len = 0;
+
+	for (int c = 0; c < iovcnt; c++) {
+		len += iov[c].iov_len;
+	}
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = (struct iovec *)iov;
+	msg.msg_iovlen = iovcnt;
+
+	// one frame is always sent as one message
+	ssize_t r;
+
+	while ((r = sendmsg(self->mainSocket, &msg, 0)) < 0) {
+		if (errno == EAGAIN || errno == EWOULDBLOCK) {
+			wait_fd(self->mainSocket, POLLOUT);
+		} else if (errno != EINTR) {
+			break;
+		}
+	}
+	if (r < 0) {
+		return -EIO;
+	} else if ((size_t)r != len) {
+		return -EINVAL;
+	}
+	return 0;
+}
+
+static int seqpacket_fill(struct instrulink *self)
+{
+	// a frame is one message so there is nothing to append to a buffered one
+	if (self->rx.pos < self->rx.len) {
+		return 0;
+	}
+
+	struct iovec iov = { .iov_base = self->rx.data, .iov_len = sizeof(self->rx.data) };
+	struct msghdr msg;
+	ssize_t r;
+
+	memset(&msg, 0, sizeof(msg));
+	msg.msg_iov = &iov;
+	msg.msg_iovlen = 1;
+
+	while ((r = recvmsg(self->mainSocket, &msg, MSG_DONTWAIT)) < 0 && errno == EINTR) {
+	}
+	if (r < 0) {
+		return errno == EAGAIN || errno == EWOULDBLOCK ? 0 : -EIO;
+	} else if (r == 0) {
+		return -EIO;
+	} else if (msg.msg_flags & MSG_TRUNC) {
+		return -EINVAL;
+	}
+	self->rx.len = r;
+	self->rx.pos = 0;
+	return 0;
+}
+
+static const struct instrulink_transport seqpacket_transport = {
+	.recv = seqpacket_recv,
+	.send = seqpacket_send,
+	.send_irq = socket_send_irq,
+	// a received frame always holds the whole request
+	.pending = stream_has_request,
+	.fill = seqpacket_fill,
+	.flush = NULL,
+	.shutdown = NULL,
+	.close = socket_close,
+};
+
+#ifdef __linux__
+static int shm_recv(struct instrulink *self, void *data, size_t len)
+{
+	struct instrulink_shm_ring *ring = &self->shm->req;
+
+	// spinning on the head index avoids the futex round trip
+	if (self->busy_poll.ns && instrulink_shm_ring_used(ring) < len) {
+		uint64_t deadline = monotonic_ns() + self->busy_poll.ns;
+
+		while (instrulink_shm_ring_used(ring) < len && monotonic_ns() < deadline) {
+			cpu_relax();
+		}
+	}
+	if (instrulink_shm_ring_used(ring) >= len) {
+		self->busy_poll.stats.polled++;
+	} else {
+		self->busy_poll.stats.blocked++;
+	}
+	return instrulink_shm_ring_read(self->shm, ring, data, len);
+}
+
+static int shm_send(struct instrulink *self, const struct iovec *iov, int iovcnt)
+{
+	for (int c = 0; c < iovcnt; c++) {
+		int r = instrulink_shm_ring_write(self->shm, &self->shm->res, iov[c].iov_base,
+						  iov[c].iov_len);
+
+		if (r != 0) {
+			return r;
+		}
+	}
+	return 0;
+}
+
+static int shm_send_irq(struct instrulink *self, const void *data, size_t len)
+{
+	return instrulink_shm_ring_write(self->shm, &self->shm->irq, data, len);
+}
+
+/** Returns true if a complete request (with its operations or payload) is already in the ring */
+static bool shm_pending(struct instrulink *self)
+{
+	uint32_t used = instrulink_shm_ring_used(&self->shm->req);
+	struct instrulink_packet hdr;
+
+	if (used < sizeof(hdr)) {
+		return false;
+	}
+	instrulink_shm_ring_peek(&self->shm->req, &hdr, sizeof(hdr));
+
+	// a block larger than the ring only completes while it is being received
+	size_t size = frame_size(&hdr);
+
+	return used >= (size < INSTRULINK_SHM_RING_SIZE ? size : INSTRULINK_SHM_RING_SIZE);
+}
+
+static void shm_shutdown(struct instrulink *self)
+{
+	// the simulator sees the flag as a disconnect and our own sleeper wakes up
+	instrulink_shm_close(self->shm);
+}
+
+static void shm_close(struct instrulink *self)
+{
+	instrulink_shm_close(self->shm);
+	munmap(self->shm, sizeof(*self->shm));
+	self->shm = NULL;
+}
+
+static const struct instrulink_transport shm_transport = {
+	.recv = shm_recv,
+	.send = shm_send,
+	.send_irq = shm_send_irq,
+	.pending = shm_pending,
+	.fill = NULL,
+	.flush = NULL,
+	.shutdown = shm_shutdown,
+	.close = shm_close,
+};
+#endif
+
 struct instrulink *instrulink_new(void)
 {
 	struct instrulink *self = (struct instrulink *)malloc(sizeof(struct instrulink));
@@ -74,52 +586,274 @@ int instrulink_connect(struct instrulink *self, int mainPort, int irqPort, const
 		close(self->irqSocket);
 		return -ECONNREFUSED;
 	}
+	self->rx.len = 0;
+	self->rx.pos = 0;
+	self->tx.len = 0;
+	self->transport = &stream_transport;
 	return 0;
 }
 
-int instrulink_disconnect(struct instrulink *self)
+static int unix_connect(const char *path)
 {
-	close(self->mainSocket);
-	close(self->irqSocket);
-	return 0;
+	struct sockaddr_un addr;
+	size_t len = strlen(path);
+
+	if (len == 0 || len >= sizeof(addr.sun_path)) {
+		return -EINVAL;
+	}
+
+	int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+
+	if (fd == -1) {
+		return -ECONNREFUSED;
+	}
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sun_family = AF_UNIX;
+	memcpy(addr.sun_path, path, len);
+	if (path[0] == '@') {
+		// abstract socket namespace
+		addr.sun_path[0] = 0;
+	}
+
+	if (connect(fd, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + len) !=
+	    0) {
+		close(fd);
+		return -ECONNREFUSED;
+	}
+	return fd;
 }
 
-int instrulink_wait_request(struct instrulink *self, struct instrulink_packet *req)
+int instrulink_connect_unix(struct instrulink *self, const char *mainPath, const char *irqPath)
 {
-	int r = recv(self->mainSocket, req, sizeof(*req), 0);
+	self->mainSocket = unix_connect(mainPath);
+	if (self->mainSocket < 0) {
+		return self->mainSocket;
+	}
 
-	if (r < 0) {
-		return -EIO;
-	} else if (r != sizeof(*req)) {
-		return -EINVAL;
+	self->irqSocket = unix_connect(irqPath);
+	if (self->irqSocket < 0) {
+		fprintf(stderr, "Could not connect to %s\n", irqPath);
+		close(self->mainSocket);
+		return self->irqSocket;
 	}
+
+	self->rx.len = 0;
+	self->rx.pos = 0;
+	self->transport = &seqpacket_transport;
 	return 0;
 }
 
-int instrulink_send_response(struct instrulink *self, struct instrulink_packet *res)
+int instrulink_connect_shm(struct instrulink *self, const char *name)
 {
-	int r = send(self->mainSocket, res, sizeof(*res), 0);
+#ifdef __linux__
+	int fd;
 
-	if (r < 0) {
-		return -EIO;
-	} else if (r != sizeof(*res)) {
+	if (strncmp(name, "fd:", 3) == 0) {
+		// memfd inherited from the simulator
+		fd = dup(atoi(name + 3));
+	} else {
+		fd = shm_open(name, O_RDWR, 0);
+	}
+
+	if (fd < 0) {
+		return -ECONNREFUSED;
+	}
+
+	struct stat st;
+
+	if (fstat(fd, &st) != 0 || (size_t)st.st_size < sizeof(struct instrulink_shm)) {
+		close(fd);
+		return -EINVAL;
+	}
+
+	void *mem = mmap(NULL, sizeof(struct instrulink_shm), PROT_READ | PROT_WRITE, MAP_SHARED,
+			 fd, 0);
+
+	close(fd);
+
+	if (mem == MAP_FAILED) {
+		return -ECONNREFUSED;
+	}
+
+	struct instrulink_shm *shm = (struct instrulink_shm *)mem;
+
+	if (__atomic_load_n(&shm->magic, __ATOMIC_ACQUIRE) != INSTRULINK_SHM_MAGIC ||
+	    shm->version != INSTRULINK_SHM_VERSION) {
+		munmap(mem, sizeof(struct instrulink_shm));
 		return -EINVAL;
 	}
+
+	// lets the simulator notice when we die while it waits on a ring
+	__atomic_store_n(&shm->instrument_pid, getpid(), __ATOMIC_RELEASE);
+	self->shm = shm;
+	self->transport = &shm_transport;
 	return 0;
+#else
+	return -ENOTSUP;
+#endif
 }
 
-int instrulink_irq_notify(struct instrulink *self)
+int instrulink_disconnect(struct instrulink *self)
 {
-	struct instrulink_packet res;
+	if (self->transport) {
+		self->transport->close(self);
+		self->transport = NULL;
+	}
+	return 0;
+}
 
-	res.type = MSG_TYPE_IRQ;
+void instrulink_shutdown(struct instrulink *self)
+{
+	if (self->transport && self->transport->shutdown) {
+		self->transport->shutdown(self);
+	}
+}
 
-	int r = send(self->irqSocket, &res, sizeof(res), 0);
+int instrulink_fd(struct instrulink *self)
+{
+#ifdef __linux__
+	if (self->transport == &shm_transport) {
+		// rings are waited on with futexes
+		return -1;
+	}
+#endif
+	return self->transport ? self->mainSocket : -1;
+}
 
-	if (r < 0) {
-		return -EIO;
-	} else if (r != sizeof(res)) {
-		return -EINVAL;
+int instrulink_irq_fd(struct instrulink *self)
+{
+#ifdef __linux__
+	if (self->transport == &shm_transport) {
+		return -1;
+	}
+#endif
+	return self->transport ? self->irqSocket : -1;
+}
+
+/** Read every page of a region so that later accesses do not fault */
+static void prefault(const void *data, size_t len)
+{
+	const volatile uint8_t *p = (const volatile uint8_t *)data;
+	long page = sysconf(_SC_PAGESIZE);
+
+	for (size_t c = 0; c < len; c += page) {
+		(void)p[c];
+	}
+	if (len) {
+		(void)p[len - 1];
+	}
+}
+
+void instrulink_prefault(struct instrulink *self)
+{
+	prefault(self, sizeof(*self));
+#ifdef __linux__
+	if (self->shm) {
+		prefault(self->shm, sizeof(*self->shm));
+	}
+#endif
+}
+
+void instrulink_set_busy_poll(struct instrulink *self, uint32_t us)
+{
+	self->busy_poll.ns = (uint64_t)us * 1000;
+}
+
+void instrulink_get_wait_stats(struct instrulink *self, struct instrulink_wait_stats *stats)
+{
+	*stats = self->busy_poll.stats;
+}
+
+int instrulink_pending(struct instrulink *self)
+{
+	return self->transport && self->transport->pending(self);
+}
+
+int instrulink_set_nonblocking(struct instrulink *self)
+{
+	int fd = instrulink_fd(self);
+	int flags = fd < 0 ? -1 : fcntl(fd, F_GETFL);
+
+	if (flags < 0 || fcntl(fd, F_SETFL, flags | O_NONBLOCK) != 0) {
+		return -ENOTSUP;
 	}
 	return 0;
 }
+
+int instrulink_receive(struct instrulink *self)
+{
+	if (!self->transport || !self->transport->fill) {
+		return -ENOTSUP;
+	}
+	return self->transport->fill(self);
+}
+
+int instrulink_flush(struct instrulink *self)
+{
+	if (!self->transport || !self->transport->flush) {
+		return 0;
+	}
+	return self->transport->flush(self);
+}
+
+int instrulink_wait_request(struct instrulink *self, struct instrulink_packet *req)
+{
+	return self->transport->recv(self, req, sizeof(*req));
+}
+
+int instrulink_send_response(struct instrulink *self, struct instrulink_packet *res)
+{
+	struct iovec iov = { .iov_base = res, .iov_len = sizeof(*res) };
+
+	return self->transport->send(self, &iov, 1);
+}
+
+int instrulink_wait_batch(struct instrulink *self, struct instrulink_packet *ops, size_t count)
+{
+	return self->transport->recv(self, ops, count * sizeof(*ops));
+}
+
+int instrulink_send_batch_response(struct instrulink *self, struct instrulink_packet *res,
+				   size_t count)
+{
+	struct instrulink_packet hdr;
+
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = MSG_TYPE_BATCH;
+	hdr.value = count;
+
+	struct iovec iov[2] = {
+		{ .iov_base = &hdr, .iov_len = sizeof(hdr) },
+		{ .iov_base = res, .iov_len = count * sizeof(*res) },
+	};
+
+	return self->transport->send(self, iov, 2);
+}
+
+int instrulink_wait_block(struct instrulink *self, void *data, size_t len)
+{
+	return self->transport->recv(self, data, len);
+}
+
+int instrulink_send_block_response(struct instrulink *self, struct instrulink_packet *res,
+				   const void *data, size_t len)
+{
+	struct iovec iov[2] = {
+		{ .iov_base = res, .iov_len = sizeof(*res) },
+		{ .iov_base = (void *)data, .iov_len = len },
+	};
+
+	return self->transport->send(self, iov, 2);
+}
+
+int instrulink_irq_notify(struct instrulink *self, uint64_t lines)
+{
+	struct instrulink_packet res;
+
+	memset(&res, 0, sizeof(res));
+	res.type = MSG_TYPE_IRQ;
+	res.value = lines;
+
+	return self->transport->send_irq(self, &res, sizeof(res));
+}
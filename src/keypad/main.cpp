@@ -24,14 +24,14 @@
  **/
 
 #include "InstrumentContainer.h"
-#include "KeypadInstrument.h"
+#include "KeypadInstrumentView.h"
 
 int main(int argc, char **argv)
 {
 	InstrumentContainer window;
-	KeypadInstrument keypad;
+	KeypadInstrumentView keypad;
 	window.init(argc, argv);
-	window.addInstrument(&keypad);
+	window.addInstrument(&keypad, 0, sizeof(struct keypad_instrument));
 	window.show();
 
 	return 0;
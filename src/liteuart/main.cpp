@@ -7,21 +7,22 @@
  **/
 
 #include "InstrumentContainer.h"
-#include "UARTInstrument.h"
+#include "UARTInstrumentView.h"
 #include "LiteUART.h"
 
 int main(int argc, char **argv)
 {
 	InstrumentContainer window;
+	window.init(argc, argv);
 
 	// Create a Wishbone verilog uart
 	std::unique_ptr<IPeripheral> liteuart(new LiteUART());
 
 	// Create instrumentation for visualizing its state
-	UARTInstrument *ins = new UARTInstrument(std::move(liteuart));
+	UARTInstrument *ins = new UARTInstrumentView(std::move(liteuart));
 
 	// Add the new instrument to the window
-	window.addInstrument(ins);
+	window.addInstrument(ins, 0, LITEUART_REG_SIZE);
 
 	window.show();
 
@@ -0,0 +1,124 @@
+// SPDX-License-Identifier: Apache-2.0
+// Copyright 2022 Martin Schröder <info@swedishembedded.com>
+//
+// AXI4-Lite register file used to test AxiLiteSlave.
+//
+// Sixteen 32 bit registers at offsets 0x00-0x3c. Other offsets get a SLVERR
+// response. A request is taken every cycle and answered LATENCY cycles
+// later, so a master that waits for each response spends LATENCY + 2 cycles
+// per access while one that keeps requests in flight needs about one.
+// The interrupt output is high while the last register is not zero.
+
+/* verilator lint_off WIDTH */
+
+module axiliteregs #(
+	parameter LATENCY = 4
+) (
+	input axi_aclk,
+	input axi_aresetn,
+	input [11:0] axi_awaddr,
+	input axi_awvalid,
+	output axi_awready,
+	input [31:0] axi_wdata,
+	input [3:0] axi_wstrb,
+	input axi_wvalid,
+	output axi_wready,
+	output [1:0] axi_bresp,
+	output axi_bvalid,
+	input axi_bready,
+	input [11:0] axi_araddr,
+	input axi_arvalid,
+	output axi_arready,
+	output [31:0] axi_rdata,
+	output [1:0] axi_rresp,
+	output axi_rvalid,
+	input axi_rready,
+	output irq
+);
+
+localparam OKAY = 2'b00;
+localparam SLVERR = 2'b10;
+
+reg [31:0] regs [0:15];
+
+// write address and data are held until both of them have arrived
+reg aw_full = 1'd0;
+reg [11:0] aw_addr = 12'd0;
+reg w_full = 1'd0;
+reg [31:0] w_data = 32'd0;
+reg [3:0] w_strb = 4'd0;
+
+// response pipelines, the last stage drives the response channel
+reg [LATENCY-1:0] b_valid = 0;
+reg [2*LATENCY-1:0] b_resp = 0;
+reg [LATENCY-1:0] r_valid = 0;
+reg [2*LATENCY-1:0] r_resp = 0;
+reg [32*LATENCY-1:0] r_data = 0;
+
+// a pipeline only stalls while its response waits for the master
+wire b_move = !axi_bvalid || axi_bready;
+wire r_move = !axi_rvalid || axi_rready;
+
+wire write_go = aw_full && w_full && b_move;
+wire read_go = axi_arvalid && r_move;
+
+wire aw_ok = aw_addr < 12'h040;
+wire ar_ok = axi_araddr < 12'h040;
+
+assign axi_awready = !aw_full || write_go;
+assign axi_wready = !w_full || write_go;
+assign axi_arready = r_move;
+
+assign axi_bvalid = b_valid[LATENCY-1];
+assign axi_bresp = b_resp[2*LATENCY-1:2*LATENCY-2];
+assign axi_rvalid = r_valid[LATENCY-1];
+assign axi_rresp = r_resp[2*LATENCY-1:2*LATENCY-2];
+assign axi_rdata = r_data[32*LATENCY-1:32*LATENCY-32];
+
+assign irq = regs[15] != 32'd0;
+
+integer i;
+
+always @(posedge axi_aclk) begin
+	if (!axi_aresetn) begin
+		aw_full <= 1'd0;
+		w_full <= 1'd0;
+		b_valid <= 0;
+		r_valid <= 0;
+		for (i = 0; i < 16; i = i + 1) begin
+			regs[i] <= 32'd0;
+		end
+	end else begin
+		if (axi_awvalid && axi_awready) begin
+			aw_full <= 1'd1;
+			aw_addr <= axi_awaddr;
+		end else if (write_go) begin
+			aw_full <= 1'd0;
+		end
+		if (axi_wvalid && axi_wready) begin
+			w_full <= 1'd1;
+			w_data <= axi_wdata;
+			w_strb <= axi_wstrb;
+		end else if (write_go) begin
+			w_full <= 1'd0;
+		end
+		if (write_go && aw_ok) begin
+			for (i = 0; i < 4; i = i + 1) begin
+				if (w_strb[i]) begin
+					regs[aw_addr[5:2]][8*i +: 8] <= w_data[8*i +: 8];
+				end
+			end
+		end
+		if (b_move) begin
+			b_valid <= {b_valid[LATENCY-2:0], write_go};
+			b_resp <= {b_resp[2*LATENCY-3:0], aw_ok ? OKAY : SLVERR};
+		end
+		if (r_move) begin
+			r_valid <= {r_valid[LATENCY-2:0], read_go};
+			r_resp <= {r_resp[2*LATENCY-3:0], ar_ok ? OKAY : SLVERR};
+			r_data <= {r_data[32*LATENCY-33:0], ar_ok ? regs[axi_araddr[5:2]] : 32'd0};
+		end
+	end
+end
+
+endmodule
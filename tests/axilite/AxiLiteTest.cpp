@@ -0,0 +1,195 @@
+#include "bus/AxiLiteSlave.h"
+#include "VAxiLiteRegs.h"
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <stdio.h>
+
+#include <memory>
+
+#define AXILITE_REG_COUNT 16
+#define AXILITE_REG_IRQ 0x3c
+#define AXILITE_REG_UNMAPPED 0x100
+
+/** Cycles from a request to its response in the test device */
+#define AXILITE_LATENCY 4
+
+/** AXI4-Lite register file with an interrupt while the last register is set */
+class AxiLiteRegs : public AxiLiteSlave<VAxiLiteRegs> {
+    public:
+	AxiLiteRegs() : AxiLiteSlave<VAxiLiteRegs>(new VAxiLiteRegs())
+	{
+	}
+	~AxiLiteRegs()
+	{
+		delete this->dev;
+	}
+
+    protected:
+	bool irqLine() override
+	{
+		return this->dev->irq;
+	}
+};
+
+TEST(Test, RegistersShouldReadBackWhatWasWritten)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	uint64_t value = 0;
+
+	for (int c = 0; c < AXILITE_REG_COUNT; c++) {
+		EXPECT_EQ(0, regs->write32(c * 4, 0x11111111u * c + 0xa5));
+	}
+	for (int c = 0; c < AXILITE_REG_COUNT; c++) {
+		EXPECT_EQ(0, regs->read32(c * 4, &value));
+		EXPECT_EQ(0x11111111u * c + 0xa5, value);
+	}
+}
+
+TEST(Test, NarrowWritesShouldOnlyStrobeTheirLanes)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, regs->write32(8, 0x44332211));
+	EXPECT_EQ(0, regs->write8(9, 0xaa));
+	EXPECT_EQ(0, regs->read32(8, &value));
+	EXPECT_EQ(0x4433aa11u, value);
+	EXPECT_EQ(0, regs->write16(10, 0xbbcc));
+	EXPECT_EQ(0, regs->read32(8, &value));
+	EXPECT_EQ(0xbbccaa11u, value);
+
+	EXPECT_EQ(0, regs->read8(11, &value));
+	EXPECT_EQ(0xbb, value);
+	EXPECT_EQ(0, regs->read16(8, &value));
+	EXPECT_EQ(0xaa11, value);
+	EXPECT_EQ(-EINVAL, regs->read16(9, &value));
+	EXPECT_EQ(-EINVAL, regs->write16(11, 0));
+}
+
+TEST(Test, OutstandingWritesShouldOverlap)
+{
+	uint32_t out[AXILITE_REG_COUNT];
+	uint32_t in[AXILITE_REG_COUNT];
+	uint64_t serial_cycles = 0;
+
+	for (int c = 0; c < AXILITE_REG_COUNT; c++) {
+		out[c] = 0x01020304u * (c + 1);
+	}
+	for (unsigned outstanding : { 1, 8 }) {
+		std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+
+		regs->setOutstanding(outstanding);
+
+		uint64_t start = regs->cycles();
+
+		EXPECT_EQ(0, regs->writeBlock(0, (uint8_t *)out, sizeof(out)));
+
+		uint64_t cycles = regs->cycles() - start;
+
+		EXPECT_EQ(0, regs->readBlock(0, (uint8_t *)in, sizeof(in)));
+		EXPECT_EQ(0, memcmp(out, in, sizeof(in)));
+		if (outstanding == 1) {
+			// every write waits for its response
+			EXPECT_GE(cycles, AXILITE_REG_COUNT * AXILITE_LATENCY);
+			serial_cycles = cycles;
+		} else {
+			// one write per cycle once the pipeline is full
+			EXPECT_LT(cycles, AXILITE_REG_COUNT + 2 * AXILITE_LATENCY);
+			EXPECT_LT(cycles * 3, serial_cycles);
+		}
+	}
+}
+
+TEST(Test, ReadsAndWritesShouldUseIndependentChannels)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	uint32_t low[8], high[8];
+	uint32_t out[8];
+	uint32_t in[8];
+
+	for (int c = 0; c < 8; c++) {
+		low[c] = 0xc0de0000u + c;
+	}
+	EXPECT_EQ(0, regs->writeBlock(0, (uint8_t *)low, sizeof(low)));
+
+	// the upper half is written while the lower half is read back
+	for (int c = 0; c < 8; c++) {
+		out[c] = 0xbeef0000u + c;
+	}
+
+	uint64_t start = regs->cycles();
+
+	EXPECT_EQ(0, regs->transfer(0x20, (uint8_t *)out, 8, 0, (uint8_t *)in, 8));
+
+	uint64_t both = regs->cycles() - start;
+
+	EXPECT_EQ(0, memcmp(low, in, sizeof(in)));
+	EXPECT_EQ(0, regs->readBlock(0x20, (uint8_t *)high, sizeof(high)));
+	EXPECT_EQ(0, memcmp(out, high, sizeof(high)));
+
+	start = regs->cycles();
+	EXPECT_EQ(0, regs->writeBlock(0x20, (uint8_t *)out, sizeof(out)));
+	EXPECT_EQ(0, regs->readBlock(0, (uint8_t *)in, sizeof(in)));
+	EXPECT_LT(both, regs->cycles() - start);
+}
+
+TEST(Test, ErrorResponsesShouldReturnEIO)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	uint32_t block[4] = { 1, 2, 3, 4 };
+	uint64_t value = 0;
+
+	EXPECT_EQ(-EIO, regs->write32(AXILITE_REG_UNMAPPED, 1));
+	EXPECT_EQ(-EIO, regs->read32(AXILITE_REG_UNMAPPED, &value));
+	EXPECT_EQ(~0ULL, value);
+
+	// a block running past the last register fails without losing the words before it
+	EXPECT_EQ(-EIO, regs->writeBlock(0x38, (uint8_t *)block, sizeof(block)));
+	EXPECT_EQ(0, regs->read32(0x38, &value));
+	EXPECT_EQ(1, value);
+	EXPECT_EQ(-EINVAL, regs->writeBlock(2, (uint8_t *)block, sizeof(block)));
+}
+
+TEST(Test, InterruptShouldFollowRegister)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	int calls = 0;
+
+	regs->onIRQ([&calls]() { calls++; });
+	EXPECT_FALSE(regs->pollIRQ());
+	EXPECT_EQ(0, regs->write32(AXILITE_REG_IRQ, 1));
+	EXPECT_TRUE(regs->pollIRQ());
+	EXPECT_EQ(1, calls);
+	EXPECT_EQ(0, regs->write32(AXILITE_REG_IRQ, 0));
+	EXPECT_FALSE(regs->pollIRQ());
+	EXPECT_EQ(1, calls);
+}
+
+TEST(Test, AdvanceShouldRunClockCycles)
+{
+	std::unique_ptr<AxiLiteRegs> regs(new AxiLiteRegs());
+	uint64_t start = regs->cycles();
+
+	regs->setClockFrequency(100000000);
+	regs->advance(1000);
+	EXPECT_EQ(100, regs->lag());
+
+	// the cycles are only run once the model is observed
+	EXPECT_EQ(start, regs->cycles());
+	EXPECT_FALSE(regs->pollIRQ());
+	EXPECT_EQ(100, regs->cycles() - start);
+
+	// fractions of a cycle carry over into the next quantum
+	regs->advance(15);
+	regs->advance(5);
+	regs->catchUp();
+	EXPECT_EQ(102, regs->cycles() - start);
+	EXPECT_EQ(0, regs->lag());
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
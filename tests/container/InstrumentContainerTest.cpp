@@ -0,0 +1,1256 @@
+#include "InstrumentContainer.h"
+#include "InstrumentHost.h"
+#include "KeypadInstrument.h"
+
+#include <instruments/protocol/protocol.h>
+
+#include <gtest/gtest.h>
+#include <errno.h>
+#include <stdio.h>
+#include <chrono>
+#include <condition_variable>
+#include <future>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include <unistd.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+class TestContainer : public InstrumentContainer {
+    public:
+	using InstrumentContainer::read32;
+	using InstrumentContainer::write32;
+	using InstrumentContainer::read8;
+	using InstrumentContainer::write8;
+	using InstrumentContainer::handleRequest;
+	using InstrumentContainer::executeBatch;
+	using InstrumentContainer::commitTouched;
+	using InstrumentContainer::readBlock;
+	using InstrumentContainer::writeBlock;
+	using InstrumentContainer::beginTransaction;
+	using InstrumentContainer::endTransaction;
+	using InstrumentContainer::startEventThread;
+	using InstrumentContainer::stopEventThread;
+
+	using InstrumentContainer::attach;
+	using InstrumentContainer::detach;
+
+	/** Record real-time requests instead of changing the whole test process */
+	int setRealTimePriority(int priority) override
+	{
+		fifoPriority = priority;
+		return 0;
+	}
+	int lockMemory(size_t heap) override
+	{
+		lockedHeap = heap;
+		return 0;
+	}
+	int fifoPriority = 0;
+	size_t lockedHeap = 0;
+
+	/** Record notifications instead of sending them */
+	void emitIRQ(uint64_t lines) override
+	{
+		std::unique_lock<std::mutex> guard(irqLock);
+
+		// a held delivery keeps the loop thread here until it is released
+		stuck = held;
+		irqChanged.notify_all();
+		irqChanged.wait(guard, [this] { return !held; });
+		stuck = false;
+		irqs.push_back(lines);
+		irqChanged.notify_all();
+	}
+	/** Make the next notification block the loop until released */
+	void holdIRQ(bool hold)
+	{
+		std::lock_guard<std::mutex> guard(irqLock);
+		held = hold;
+		irqChanged.notify_all();
+	}
+	/** Wait until the loop is blocked in a held notification */
+	bool waitStuck()
+	{
+		std::unique_lock<std::mutex> guard(irqLock);
+		return irqChanged.wait_for(guard, std::chrono::seconds(5), [this] { return stuck; });
+	}
+	/** Wait until count notifications were sent and return the last one (0 on timeout) */
+	uint64_t waitIRQ(size_t count)
+	{
+		std::unique_lock<std::mutex> guard(irqLock);
+
+		if (!irqChanged.wait_for(guard, std::chrono::seconds(5),
+					 [this, count] { return irqs.size() >= count; })) {
+			return 0;
+		}
+		return irqs[count - 1];
+	}
+	size_t irqCount()
+	{
+		std::lock_guard<std::mutex> guard(irqLock);
+		return irqs.size();
+	}
+	std::mutex irqLock;
+	std::condition_variable irqChanged;
+	std::vector<uint64_t> irqs;
+	bool held = false;
+	bool stuck = false;
+};
+
+/** Run everything that is ready on a loop driven by the test thread */
+static void drain(EventLoop *loop)
+{
+	while (loop->poll(0) > 0) {
+	}
+}
+
+/** Plain register file instrument */
+class RegisterInstrument : public BaseInstrument<struct keypad_instrument> {
+    public:
+	RegisterInstrument()
+	{
+		memset(&this->regs, 0, sizeof(this->regs));
+	}
+	void render() override
+	{
+	}
+	void raise()
+	{
+		notifyIRQ();
+	}
+	using BaseInstrument::view;
+	using BaseInstrument::editRegister;
+};
+
+/** Register file accessible with any width that counts writes to one register */
+class ByteInstrument : public BaseInstrument<struct keypad_instrument, ByteInstrument> {
+    public:
+	static const unsigned WIDTHS = sizeof(uint8_t) | sizeof(uint16_t) | sizeof(uint32_t);
+
+	ByteInstrument()
+	{
+		memset(&this->regs, 0, sizeof(this->regs));
+	}
+	template <typename W> int write(uint64_t addr, uint64_t value)
+	{
+		if (addr == KEYPAD_REG_KEYS_CHANGED) {
+			writes++;
+		}
+		return BaseInstrument::write<W>(addr, value);
+	}
+	unsigned writes = 0;
+};
+
+struct attribute_regs {
+	uint32_t id;
+	uint32_t status;
+	uint32_t flags;
+	uint32_t data;
+} __attribute__((packed)) __attribute__((aligned(4)));
+
+/** Register file with one register of each kind */
+class AttributeInstrument : public BaseInstrument<struct attribute_regs> {
+    public:
+	AttributeInstrument()
+	{
+		memset(&this->regs, 0, sizeof(this->regs));
+		this->regs.id = 0x1d;
+		defineRegister(&this->regs.id, REG_RO | REG_PURE);
+		defineRegister(&this->regs.status, REG_RC | REG_VOLATILE);
+		defineRegister(&this->regs.flags, REG_W1C | REG_VOLATILE | REG_PURE);
+		defineRegister(&this->regs.data, REG_PURE);
+	}
+	void set(uint32_t status, uint32_t flags)
+	{
+		this->regs.status = status;
+		this->regs.flags = flags;
+	}
+	using BaseInstrument::view;
+	using BaseInstrument::editRegister;
+};
+
+/** Instrument simulated by a timer instead of by rendering */
+class TimerInstrument : public RegisterInstrument {
+    public:
+	void setupTimers(TimerRegistry addTimer) override
+	{
+		addTimer(1000000ULL, [this] {
+			this->regs.keys++;
+			notifyIRQ();
+		});
+	}
+};
+
+TEST(Test, OverlappingInstrumentsShouldBeRejected)
+{
+	TestContainer c;
+	KeypadInstrument a, b;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, 0x100));
+	EXPECT_EQ(-EEXIST, c.addInstrument(&b, 0x1000, 0x100));
+	EXPECT_EQ(-EEXIST, c.addInstrument(&b, 0x0f80, 0x100));
+	EXPECT_EQ(-EEXIST, c.addInstrument(&b, 0x10ff, 0x100));
+	EXPECT_EQ(-EEXIST, c.addInstrument(&b, 0x0000, 0x10000));
+	EXPECT_EQ(-EINVAL, c.addInstrument(&b, 0x2000, 0));
+	EXPECT_EQ(0, c.addInstrument(&b, 0x1100, 0x100));
+	EXPECT_EQ(0, c.addInstrument(&b, 0x0f00, 0x100));
+}
+
+TEST(Test, AccessesShouldBeDecodedToInstrumentOffsets)
+{
+	TestContainer c;
+	KeypadInstrument a, b;
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&b, 0x2000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	a.setKeyState(1, true);
+	b.setKeyState(2, true);
+
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(1 << 1, value);
+	EXPECT_EQ(0, c.read32(0x2000 + KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(1 << 2, value);
+	EXPECT_EQ(0, c.read32(0x2000 + KEYPAD_REG_KEYS_CHANGED, &value));
+	EXPECT_EQ(1 << 2, value);
+	// reading changed register of one keypad should not affect the other
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS_CHANGED, &value));
+	EXPECT_EQ(1 << 1, value);
+}
+
+TEST(Test, UnmappedAccessesShouldReturnEIO)
+{
+	TestContainer c;
+	KeypadInstrument a;
+	uint64_t value = 0;
+
+	EXPECT_EQ(-EIO, c.read32(0, &value));
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(-EIO, c.read32(0x0ffc, &value));
+	EXPECT_EQ(0xffffffffffffffff, value);
+	EXPECT_EQ(-EIO, c.read32(0x1000 + sizeof(struct keypad_instrument), &value));
+	// access straddling the end of the window
+	EXPECT_EQ(-EIO, c.read32(0x1006, &value));
+	EXPECT_EQ(-EIO, c.write32(0x2000, 0));
+	// mapped but unsupported by the instrument
+	EXPECT_EQ(-ENOTSUP, c.read8(0x1000, &value));
+}
+
+TEST(Test, AccessesShouldHonourWidth)
+{
+	TestContainer c;
+	ByteInstrument a;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	EXPECT_EQ(0, c.write32(0x1000 + KEYPAD_REG_KEYS, 0x11223344));
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_READ8;
+	req.addr = 0x1000 + KEYPAD_REG_KEYS + 1;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(0x33, res.value);
+
+	req.type = MSG_TYPE_WRITE16;
+	req.addr = 0x1000 + KEYPAD_REG_KEYS + 2;
+	req.value = 0xaabb;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(0xaabb3344, value);
+
+	// accesses of every width reach the hook of the instrument
+	EXPECT_EQ(0, c.write8(0x1000 + KEYPAD_REG_KEYS_CHANGED, 1));
+	EXPECT_EQ(0, c.write32(0x1000 + KEYPAD_REG_KEYS_CHANGED, 1));
+	EXPECT_EQ(2, a.writes);
+	EXPECT_EQ(-ENOTSUP, a.access(0, 8, false, &value));
+	// only exact widths are served
+	for (unsigned width : { 3, 5, 6, 7 }) {
+		EXPECT_EQ(-ENOTSUP, a.access(0, width, false, &value)) << width;
+	}
+}
+
+TEST(Test, RegisterAttributesShouldApplyToAccesses)
+{
+	TestContainer c;
+	AttributeInstrument a;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct attribute_regs)));
+	a.set(0x3, 0xf0);
+
+	EXPECT_EQ(0, c.write32(0x1000, 0x55));
+	EXPECT_EQ(0, c.read32(0x1000, &value));
+	EXPECT_EQ(0x1d, value);
+	EXPECT_EQ(0, c.read32(0x1004, &value));
+	EXPECT_EQ(0x3, value);
+	EXPECT_EQ(0, c.read32(0x1004, &value));
+	EXPECT_EQ(0, value);
+	EXPECT_EQ(0, c.write32(0x1008, 0x30));
+	EXPECT_EQ(0, c.read32(0x1008, &value));
+	EXPECT_EQ(0xc0, value);
+
+	// only reads without side effects are answered from the snapshot
+	a.commit();
+	EXPECT_EQ(0, a.peek(0x0, sizeof(uint32_t), &value));
+	EXPECT_EQ(0x1d, value);
+	EXPECT_EQ(0, a.peek(0x8, sizeof(uint32_t), &value));
+	EXPECT_EQ(0xc0, value);
+	EXPECT_EQ(-EAGAIN, a.peek(0x4, sizeof(uint32_t), &value));
+	EXPECT_EQ(-EAGAIN, a.peek(0x2, sizeof(uint32_t), &value));
+	EXPECT_EQ(-EAGAIN, a.peek(0xe, sizeof(uint32_t), &value));
+
+	// id and data are the only registers the simulator may cache
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_CACHEABLE;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(0x1000, res.addr);
+	EXPECT_EQ(4, res.value);
+	req.addr = 1;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(0x100c, res.addr);
+	EXPECT_EQ(4, res.value);
+	req.addr = 2;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_ERROR, res.type);
+}
+
+TEST(Test, UndeclaredRegistersShouldNotBePeekedOrCached)
+{
+	TestContainer c;
+	TimerInstrument a;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+	uint64_t value = 0;
+
+	// the timer changes keys behind the back of the simulator
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+	a.commit();
+	EXPECT_EQ(-EAGAIN, a.peek(KEYPAD_REG_KEYS, sizeof(uint32_t), &value));
+	EXPECT_TRUE(a.cacheable().empty());
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_CACHEABLE;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_ERROR, res.type);
+}
+
+TEST(Test, FenceShouldReportFailedPostedWrites)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_POSTED_WRITE32;
+	req.addr = 0x1000 + KEYPAD_REG_KEYS;
+	req.value = 0x55;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(0x55, value);
+
+	req.type = MSG_TYPE_FENCE;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+
+	// two failing posted writes are reported by one fence
+	req.type = MSG_TYPE_POSTED_WRITE32;
+	req.addr = 0x3000;
+	c.handleRequest(&req, &res);
+	req.type = MSG_TYPE_POSTED_WRITE8;
+	req.addr = 0x1000;
+	c.handleRequest(&req, &res);
+	req.type = MSG_TYPE_FENCE;
+	req.addr = 0;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_ERROR, res.type);
+	EXPECT_EQ(2, res.value);
+	EXPECT_EQ(0x3000, res.addr);
+
+	// status is reset by the fence
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+}
+
+TEST(Test, BatchedPostedWritesShouldOnlyBeReportedInBatch)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	struct instrulink_packet ops[2];
+	struct instrulink_packet res[2];
+	struct instrulink_packet req;
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].type = MSG_TYPE_POSTED_WRITE32;
+	ops[0].addr = 0x1000 + KEYPAD_REG_KEYS;
+	ops[0].value = 0x55;
+	ops[1].type = MSG_TYPE_POSTED_WRITE32;
+	ops[1].addr = 0x3000;
+	c.executeBatch(ops, res, 2);
+	EXPECT_EQ(MSG_TYPE_OK, res[0].type);
+	EXPECT_EQ(MSG_TYPE_ERROR, res[1].type);
+	EXPECT_EQ(0x3000, res[1].addr);
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(0x55, value);
+
+	// the failure was already reported in the batch response
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_FENCE;
+	c.handleRequest(&req, &res[0]);
+	EXPECT_EQ(MSG_TYPE_OK, res[0].type);
+}
+
+TEST(Test, BatchesShouldRejectNestedAndBlockOperations)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	struct instrulink_packet ops[4];
+	struct instrulink_packet res[4];
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	memset(ops, 0, sizeof(ops));
+	ops[0].type = MSG_TYPE_BATCH;
+	ops[1].type = MSG_TYPE_READ_BLOCK;
+	ops[2].type = MSG_TYPE_WRITE_BLOCK;
+	ops[3].type = MSG_TYPE_READ32;
+	for (int i = 0; i < 4; i++) {
+		ops[i].addr = 0x1000;
+		ops[i].value = 4;
+	}
+	c.executeBatch(ops, res, 4);
+	for (int i = 0; i < 3; i++) {
+		EXPECT_EQ(MSG_TYPE_ERROR, res[i].type) << i;
+	}
+	EXPECT_EQ(MSG_TYPE_OK, res[3].type);
+}
+
+/** Register file that counts how often it was committed */
+class CommitInstrument : public RegisterInstrument {
+    public:
+	void commit() override
+	{
+		commits++;
+		RegisterInstrument::commit();
+	}
+	unsigned commits = 0;
+};
+
+TEST(Test, RequestsShouldOnlyCommitTouchedInstruments)
+{
+	TestContainer c;
+	CommitInstrument a, b, d;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+	uint32_t data[2] = { 1, 2 };
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(0, c.addInstrument(&b, 0x2000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(0, c.addInstrument(&d, 0x3000, sizeof(struct keypad_instrument)));
+	a.commits = b.commits = d.commits = 0;
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_WRITE32;
+	req.addr = 0x2000 + KEYPAD_REG_KEYS;
+	c.handleRequest(&req, &res);
+	c.handleRequest(&req, &res);
+	c.commitTouched();
+	EXPECT_EQ(0, a.commits);
+	EXPECT_EQ(1, b.commits);
+	EXPECT_EQ(0, d.commits);
+
+	// unmapped accesses touch nothing
+	req.addr = 0x4000;
+	c.handleRequest(&req, &res);
+	c.commitTouched();
+	EXPECT_EQ(1, b.commits);
+
+	EXPECT_EQ(0, c.writeBlock(0x1000, (uint8_t *)data, sizeof(data)));
+	c.commitTouched();
+	EXPECT_EQ(1, a.commits);
+	EXPECT_EQ(1, b.commits);
+
+	// time passes for every instrument
+	req.type = MSG_TYPE_TICK_CLOCK;
+	req.value = 1000;
+	c.handleRequest(&req, &res);
+	c.commitTouched();
+	EXPECT_EQ(2, a.commits);
+	EXPECT_EQ(2, b.commits);
+	EXPECT_EQ(1, d.commits);
+}
+
+TEST(Test, BlockAccessesShouldCopyRegisterFile)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	uint32_t out[2] = { 0x11223344, 0x55667788 };
+	uint32_t in[2] = { 0, 0 };
+	uint64_t value = 0;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	EXPECT_EQ(0, c.writeBlock(0x1000, (uint8_t *)out, sizeof(out)));
+	EXPECT_EQ(0, c.read32(0x1000 + KEYPAD_REG_KEYS_CHANGED, &value));
+	EXPECT_EQ(0x55667788, value);
+	EXPECT_EQ(0, c.readBlock(0x1000, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(0, memcmp(in, out, sizeof(in)));
+
+	// blocks must not cross the end of the window
+	EXPECT_EQ(-EIO, c.readBlock(0x1004, (uint8_t *)in, sizeof(in)));
+}
+
+TEST(Test, BlockAccessesShouldHonourRegisterAttributes)
+{
+	AttributeInstrument a;
+	ByteInstrument b;
+	uint32_t out[4] = { 0xff, 0xff, 0x1, 0x42 };
+	uint32_t in[4] = { 0 };
+
+	// read-only registers keep their value and write-one-to-clear bits are cleared
+	a.set(0x5, 0x3);
+	EXPECT_EQ(0, a.writeBlock(0, (const uint8_t *)out, sizeof(out)));
+	EXPECT_EQ(0, a.readBlock(0, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(0x1du, in[0]);
+	EXPECT_EQ(0xffu, in[1]);
+	EXPECT_EQ(0x2u, in[2]);
+	EXPECT_EQ(0x42u, in[3]);
+
+	// and read-clear registers are cleared by the block read
+	EXPECT_EQ(0, a.readBlock(0, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(0u, in[1]);
+
+	// accesses with an action go through the instrument
+	EXPECT_EQ(0, b.writeBlock(0, (const uint8_t *)out, 2 * sizeof(out[0])));
+	EXPECT_EQ(1u, b.writes);
+}
+
+TEST(Test, DefaultBlockAccessShouldIssueWordAccesses)
+{
+	RegisterInstrument a;
+	IPeripheral *p = &a;
+	uint32_t out[2] = { 0x11223344, 0x55667788 };
+	uint32_t in[2] = { 0, 0 };
+
+	EXPECT_EQ(0, p->IPeripheral::writeBlock(0, (uint8_t *)out, sizeof(out)));
+	EXPECT_EQ(0, p->IPeripheral::readBlock(0, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(0, memcmp(in, out, sizeof(in)));
+	EXPECT_EQ(-EINVAL, p->IPeripheral::readBlock(2, (uint8_t *)in, 4));
+	EXPECT_EQ(-EIO, p->IPeripheral::readBlock(4, (uint8_t *)in, sizeof(in)));
+}
+
+/** Instrument that records how much simulated time it has been given */
+class ClockedInstrument : public RegisterInstrument {
+    public:
+	void advance(uint64_t ns) override
+	{
+		elapsed += ns;
+		calls++;
+	}
+	void endQuantum() override
+	{
+		ended = elapsed;
+		quanta++;
+	}
+	uint64_t elapsed = 0;
+	unsigned calls = 0;
+	/** Time given when the last quantum ended */
+	uint64_t ended = 0;
+	unsigned quanta = 0;
+};
+
+TEST(Test, TickClockShouldAdvanceAllInstruments)
+{
+	TestContainer c;
+	ClockedInstrument a, b;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(0, c.addInstrument(&b, 0x2000, sizeof(struct keypad_instrument)));
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_TICK_CLOCK;
+	req.value = 1000;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(1000, res.value);
+
+	req.value = 250;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(MSG_TYPE_OK, res.type);
+	EXPECT_EQ(1250, res.value);
+
+	EXPECT_EQ(1250, a.elapsed);
+	EXPECT_EQ(1250, b.elapsed);
+	EXPECT_EQ(2, a.calls);
+	EXPECT_EQ(2, b.quanta);
+	EXPECT_EQ(1250, b.ended);
+}
+
+/** Instrument with a slow model that records which threads advanced it */
+class HeavyInstrument : public RegisterInstrument {
+    public:
+	void advance(uint64_t ns) override
+	{
+		unsigned now = __atomic_add_fetch(running, 1, __ATOMIC_SEQ_CST);
+		unsigned seen = __atomic_load_n(peak, __ATOMIC_SEQ_CST);
+
+		while (now > seen &&
+		       !__atomic_compare_exchange_n(peak, &seen, now, false, __ATOMIC_SEQ_CST,
+						    __ATOMIC_SEQ_CST)) {
+		}
+		usleep(2000);
+		elapsed += ns;
+		__atomic_sub_fetch(running, 1, __ATOMIC_SEQ_CST);
+	}
+	unsigned *running;
+	unsigned *peak;
+	uint64_t elapsed = 0;
+};
+
+TEST(Test, InstrumentsShouldBeAdvancedInParallel)
+{
+	TestContainer c;
+	HeavyInstrument ins[8];
+	unsigned running = 0, peak = 0;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+
+	for (int i = 0; i < 8; i++) {
+		ins[i].running = &running;
+		ins[i].peak = &peak;
+		EXPECT_EQ(0, c.addInstrument(&ins[i], 0x1000 * (i + 1),
+					     sizeof(struct keypad_instrument)));
+	}
+	c.setTickThreads(3);
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_TICK_CLOCK;
+	req.value = 100;
+	for (int q = 0; q < 5; q++) {
+		c.handleRequest(&req, &res);
+		EXPECT_EQ(MSG_TYPE_OK, res.type);
+
+		// every quantum ends with a barrier
+		EXPECT_EQ(0u, __atomic_load_n(&running, __ATOMIC_SEQ_CST));
+		for (int i = 0; i < 8; i++) {
+			EXPECT_EQ((uint64_t)(q + 1) * 100, ins[i].elapsed);
+		}
+	}
+	EXPECT_EQ(500, res.value);
+	EXPECT_GT(peak, 1u);
+	EXPECT_LE(peak, 4u);
+}
+
+TEST(Test, TimingWheelShouldFireEventsInOrderAndSkipIdleTime)
+{
+	TimingWheel wheel(1000);
+	std::vector<std::pair<int, uint64_t> > fired;
+	TimingEvent ev[5];
+
+	for (int i = 0; i < 5; i++) {
+		ev[i].cb = [&fired, &wheel, i] { fired.push_back({ i, wheel.now() }); };
+	}
+
+	// one event in each level, one in the overflow list and one cancelled
+	wheel.schedule(&ev[0], 70000000ULL);
+	wheel.schedule(&ev[1], 5000);
+	wheel.schedule(&ev[2], 300000);
+	wheel.schedule(&ev[3], 5000000000000ULL);
+	wheel.schedule(&ev[4], 6000);
+	wheel.cancel(&ev[4]);
+	EXPECT_FALSE(ev[4].pending());
+	EXPECT_EQ(5000u, wheel.next());
+
+	wheel.run(4999);
+	EXPECT_TRUE(fired.empty());
+	wheel.run(1000000000ULL);
+	ASSERT_EQ(3u, fired.size());
+	EXPECT_EQ(std::make_pair(1, (uint64_t)5000), fired[0]);
+	EXPECT_EQ(std::make_pair(2, (uint64_t)300000), fired[1]);
+	EXPECT_EQ(std::make_pair(0, (uint64_t)70000000), fired[2]);
+	EXPECT_EQ(1000000000ULL, wheel.now());
+
+	wheel.run(6000000000000ULL);
+	ASSERT_EQ(4u, fired.size());
+	EXPECT_EQ(std::make_pair(3, (uint64_t)5000000000000ULL), fired[3]);
+	EXPECT_EQ(UINT64_MAX, wheel.next());
+
+	// periodic events are rescheduled before their callback runs
+	int count = 0;
+	TimingEvent periodic([&count] { count++; });
+
+	wheel.schedule(&periodic, 100000, 100000);
+	wheel.run(wheel.now() + 1000000);
+	EXPECT_EQ(10, count);
+	wheel.cancel(&periodic);
+	wheel.run(wheel.now() + 1000000);
+	EXPECT_EQ(10, count);
+}
+
+/** Raises its interrupt 5 ms of simulated time after the keys register is written */
+class DelayedIRQInstrument : public ClockedInstrument {
+    public:
+	DelayedIRQInstrument()
+	{
+		irq.cb = [this] {
+			fired_at = elapsed;
+			notifyIRQ();
+		};
+	}
+	void setScheduler(TimingWheel *wheel) override
+	{
+		this->wheel = wheel;
+	}
+	int access(uint64_t addr, unsigned width, bool write, uint64_t *value) override
+	{
+		if (write) {
+			wheel->schedule(&irq, 5000000);
+		}
+		return RegisterInstrument::access(addr, width, write, value);
+	}
+	TimingWheel *wheel = NULL;
+	TimingEvent irq;
+	uint64_t fired_at = 0;
+};
+
+TEST(Test, ScheduledEventsShouldFireAtTheirSimulatedTime)
+{
+	TestContainer c;
+	DelayedIRQInstrument a;
+	struct instrulink_packet req;
+	struct instrulink_packet res;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument), 1));
+	EXPECT_EQ(0, c.write32(0x1000 + KEYPAD_REG_KEYS, 1));
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_TICK_CLOCK;
+	req.value = 3000000;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(0u, a.fired_at);
+	EXPECT_EQ(1u, a.calls);
+
+	// the quantum is split at the event so the model is exactly at 5 ms when it fires
+	req.value = 10000000;
+	c.handleRequest(&req, &res);
+	EXPECT_EQ(5000000u, a.fired_at);
+	EXPECT_EQ(13000000u, a.elapsed);
+	EXPECT_EQ(3u, a.calls);
+	// but it ends once, after all of it has been granted
+	EXPECT_EQ(2u, a.quanta);
+	EXPECT_EQ(13000000u, a.ended);
+	ASSERT_EQ(0, c.startEventThread());
+	EXPECT_EQ(1 << 1, c.waitIRQ(1));
+	c.stopEventThread();
+}
+
+TEST(Test, InterruptsShouldCarryLineAndBeCoalesced)
+{
+	TestContainer c;
+	RegisterInstrument a, b;
+	EventLoop loop;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument), 3));
+	EXPECT_EQ(0, c.addInstrument(&b, 0x2000, sizeof(struct keypad_instrument), 5));
+	EXPECT_EQ(-EINVAL, c.addInstrument(&b, 0x3000, sizeof(struct keypad_instrument), 64));
+
+	// the loop only runs when drained here so nothing can slip through in between
+	// raised before attaching is delivered once attached
+	a.raise();
+	EXPECT_EQ(0, c.irqCount());
+	ASSERT_EQ(0, c.attach(&loop));
+	drain(&loop);
+	ASSERT_EQ(1, c.irqCount());
+	EXPECT_EQ(1 << 3, c.irqs[0]);
+
+	// interrupts raised by one transaction are merged
+	c.beginTransaction();
+	a.raise();
+	b.raise();
+	a.raise();
+	drain(&loop);
+	EXPECT_EQ(1, c.irqCount());
+	c.endTransaction();
+	drain(&loop);
+	ASSERT_EQ(2, c.irqCount());
+	EXPECT_EQ((1 << 3) | (1 << 5), c.irqs[1]);
+
+	// interrupts within the window are held back until it has passed
+	c.setIRQWindow(100000000ULL);
+	b.raise();
+	drain(&loop);
+	ASSERT_EQ(3, c.irqCount());
+	EXPECT_EQ(1 << 5, c.irqs[2]);
+	a.raise();
+	drain(&loop);
+	EXPECT_EQ(3, c.irqCount());
+	for (int i = 0; i < 50 && c.irqCount() < 4; i++) {
+		loop.poll(100);
+	}
+	ASSERT_EQ(4, c.irqCount());
+	EXPECT_EQ(1 << 3, c.irqs[3]);
+
+	c.detach();
+}
+
+TEST(Test, RaisingInterruptsShouldNotWaitForDelivery)
+{
+	TestContainer c;
+	RegisterInstrument a;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument), 0));
+	ASSERT_EQ(0, c.startEventThread());
+
+	// the loop thread gets stuck delivering the first notification
+	c.holdIRQ(true);
+	a.raise();
+	ASSERT_TRUE(c.waitStuck());
+
+	// raising from several threads at once never waits for the loop
+	auto raised = std::async(std::launch::async, [&a] {
+		std::vector<std::thread> threads;
+
+		for (int t = 0; t < 4; t++) {
+			threads.emplace_back([&a] {
+				for (int i = 0; i < 1000; i++) {
+					a.raise();
+				}
+			});
+		}
+		for (auto &t : threads) {
+			t.join();
+		}
+	});
+
+	EXPECT_EQ(std::future_status::ready, raised.wait_for(std::chrono::seconds(5)));
+	EXPECT_EQ(0, c.irqCount());
+
+	// and everything raised meanwhile goes out in one more notification
+	c.holdIRQ(false);
+	EXPECT_EQ(1, c.waitIRQ(1));
+	EXPECT_EQ(1, c.waitIRQ(2));
+	c.stopEventThread();
+	EXPECT_EQ(2, c.irqCount());
+}
+
+TEST(Test, TimersShouldRunOnEventLoopWithoutRendering)
+{
+	TestContainer c;
+	TimerInstrument a;
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument), 2));
+	EXPECT_EQ(-EINVAL, c.addTimer(0, [] {}));
+	ASSERT_EQ(0, c.startEventThread());
+	EXPECT_EQ(-EBUSY, c.addTimer(1000000ULL, [] {}));
+
+	// every expiration is committed so the view side sees it without a frame
+	for (int i = 0; i < 2000 && a.view.keys < 5; i++) {
+		usleep(1000);
+		a.refresh();
+	}
+	EXPECT_GE(a.view.keys, 5u);
+	EXPECT_EQ(1 << 2, c.waitIRQ(1));
+
+	// timers are gone once the container is detached
+	c.stopEventThread();
+	a.refresh();
+
+	uint32_t keys = a.view.keys;
+
+	usleep(5000);
+	a.refresh();
+	EXPECT_EQ(keys, a.view.keys);
+}
+
+TEST(Test, SnapshotReadsShouldNeverBeTorn)
+{
+	struct block {
+		uint64_t words[32];
+	};
+	Snapshot<struct block> snapshot;
+	bool done = false;
+
+	std::thread writer([&] {
+		struct block b;
+
+		for (uint64_t v = 1; v < 100000; v++) {
+			for (auto &w : b.words) {
+				w = v;
+			}
+			snapshot.publish(b);
+		}
+		__atomic_store_n(&done, true, __ATOMIC_RELEASE);
+	});
+
+	while (!__atomic_load_n(&done, __ATOMIC_ACQUIRE)) {
+		struct block b;
+
+		snapshot.read(&b);
+		for (auto w : b.words) {
+			ASSERT_EQ(b.words[0], w);
+		}
+	}
+	writer.join();
+}
+
+TEST(Test, QueuedEditsShouldBeAppliedInOrderOnCommit)
+{
+	RegisterInstrument a;
+	uint64_t value = 0;
+
+	a.commit();
+	a.refresh();
+	EXPECT_EQ(0, a.view.keys);
+
+	// edits of the view only reach the registers on commit
+	a.view.keys = 0x12;
+	a.editRegister(&a.view.keys);
+	a.view.keys = 0x34;
+	a.editRegister(&a.view.keys);
+	EXPECT_EQ(0, a.read32(KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(0, value);
+	a.refresh();
+	EXPECT_EQ(0, a.view.keys);
+
+	a.commit();
+	EXPECT_EQ(0, a.read32(KEYPAD_REG_KEYS, &value));
+	EXPECT_EQ(0x34, value);
+
+	// bus writes show up in the view after the next commit
+	EXPECT_EQ(0, a.write32(KEYPAD_REG_KEYS_CHANGED, 0x56));
+	a.refresh();
+	EXPECT_EQ(0, a.view.keys_changed);
+	a.commit();
+	a.refresh();
+	EXPECT_EQ(0x34, a.view.keys);
+	EXPECT_EQ(0x56, a.view.keys_changed);
+}
+
+TEST(Test, EditsOfCacheableRegistersShouldBeRejected)
+{
+	AttributeInstrument a;
+	uint64_t value = 0;
+
+	a.view.flags = 0x3;
+	a.editRegister(&a.view.flags);
+	// the simulator may cache data so it must not change behind its back
+	a.view.data = 0x12;
+	a.editRegister(&a.view.data);
+	a.commit();
+
+	EXPECT_EQ(0, a.read32(offsetof(struct attribute_regs, flags), &value));
+	EXPECT_EQ(0x3, value);
+	EXPECT_EQ(0, a.read32(offsetof(struct attribute_regs, data), &value));
+	EXPECT_EQ(0, value);
+}
+
+static int listenLocal(int *port)
+{
+	int fd = socket(AF_INET, SOCK_STREAM, 0);
+	struct sockaddr_in addr;
+	socklen_t len = sizeof(addr);
+
+	memset(&addr, 0, sizeof(addr));
+	addr.sin_family = AF_INET;
+	addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+	bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+	listen(fd, 1);
+	getsockname(fd, (struct sockaddr *)&addr, &len);
+	*port = ntohs(addr.sin_port);
+	return fd;
+}
+
+TEST(Test, HeadlessModeShouldServeBusWithoutWindow)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	int mainPort, irqPort;
+	int mainServer = listenLocal(&mainPort);
+	int irqServer = listenLocal(&irqPort);
+	char port1[16], port2[16];
+	struct instrulink_packet pkt;
+
+	snprintf(port1, sizeof(port1), "%d", mainPort);
+	snprintf(port2, sizeof(port2), "%d", irqPort);
+	char *argv[] = { (char *)"test", (char *)"--headless", (char *)"--telemetry", (char *)"1",
+			 port1, port2, (char *)"127.0.0.1" };
+
+	ASSERT_EQ(0, c.init(7, argv));
+	EXPECT_TRUE(c.isHeadless());
+	int mainSocket = accept(mainServer, NULL, NULL);
+	int irqSocket = accept(irqServer, NULL, NULL);
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	std::thread host([&c] { EXPECT_EQ(0, c.run()); });
+
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.type = MSG_TYPE_WRITE32;
+	pkt.addr = 0x1000 + KEYPAD_REG_KEYS;
+	pkt.value = 0x42;
+	EXPECT_EQ((int)sizeof(pkt), send(mainSocket, &pkt, sizeof(pkt), 0));
+	EXPECT_EQ((int)sizeof(pkt), recv(mainSocket, &pkt, sizeof(pkt), MSG_WAITALL));
+	EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+
+	// the write is visible to the view side without taking the lock
+	a.refresh();
+	EXPECT_EQ(0x42, a.view.keys);
+
+	pkt.type = MSG_TYPE_DISCONNECT;
+	EXPECT_EQ((int)sizeof(pkt), send(mainSocket, &pkt, sizeof(pkt), 0));
+	EXPECT_EQ((int)sizeof(pkt), recv(mainSocket, &pkt, sizeof(pkt), MSG_WAITALL));
+	host.join();
+
+	close(mainSocket);
+	close(irqSocket);
+	close(mainServer);
+	close(irqServer);
+}
+
+TEST(Test, HostShouldServeManyConnectionsFromOneThread)
+{
+	const int N = 3;
+	TestContainer c[N];
+	RegisterInstrument a[N];
+	int mainServer[N], irqServer[N];
+	int mainSocket[N], irqSocket[N];
+	InstrumentHost host;
+	struct instrulink_packet pkt;
+
+	for (int i = 0; i < N; i++) {
+		int mainPort, irqPort;
+		char port1[16], port2[16];
+
+		mainServer[i] = listenLocal(&mainPort);
+		irqServer[i] = listenLocal(&irqPort);
+		snprintf(port1, sizeof(port1), "%d", mainPort);
+		snprintf(port2, sizeof(port2), "%d", irqPort);
+		char *argv[] = { (char *)"test", port1, port2, (char *)"127.0.0.1" };
+
+		ASSERT_EQ(0, c[i].init(4, argv));
+		mainSocket[i] = accept(mainServer[i], NULL, NULL);
+		irqSocket[i] = accept(irqServer[i], NULL, NULL);
+		EXPECT_EQ(0, c[i].addInstrument(&a[i], 0x1000, sizeof(struct keypad_instrument)));
+		EXPECT_EQ(0, host.addContainer(&c[i]));
+	}
+
+	std::thread thread([&host] { EXPECT_EQ(0, host.run()); });
+
+	// a connection stopping halfway through a request does not hold up the others
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.type = MSG_TYPE_WRITE32;
+	pkt.addr = 0x1000 + KEYPAD_REG_KEYS;
+	pkt.value = 0x20;
+	EXPECT_EQ(7, send(mainSocket[0], &pkt, 7, 0));
+
+	for (int i = N - 1; i > 0; i--) {
+		struct instrulink_packet res;
+
+		res = pkt;
+		res.value = 0x10 + i;
+		EXPECT_EQ((int)sizeof(res), send(mainSocket[i], &res, sizeof(res), 0));
+		EXPECT_EQ((int)sizeof(res), recv(mainSocket[i], &res, sizeof(res), MSG_WAITALL));
+		EXPECT_EQ(MSG_TYPE_OK, res.type);
+	}
+	EXPECT_EQ((int)sizeof(pkt) - 7, send(mainSocket[0], (uint8_t *)&pkt + 7, sizeof(pkt) - 7, 0));
+	EXPECT_EQ((int)sizeof(pkt), recv(mainSocket[0], &pkt, sizeof(pkt), MSG_WAITALL));
+	EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+	a[0].refresh();
+	EXPECT_EQ(0x20u, a[0].view.keys);
+
+	// requests on every connection are served while the others stay idle
+	for (int i = N - 1; i >= 0; i--) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_WRITE32;
+		pkt.addr = 0x1000 + KEYPAD_REG_KEYS;
+		pkt.value = 0x10 + i;
+		EXPECT_EQ((int)sizeof(pkt), send(mainSocket[i], &pkt, sizeof(pkt), 0));
+		EXPECT_EQ((int)sizeof(pkt), recv(mainSocket[i], &pkt, sizeof(pkt), MSG_WAITALL));
+		EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+	}
+
+	for (int i = 0; i < N; i++) {
+		a[i].refresh();
+		EXPECT_EQ((uint32_t)(0x10 + i), a[i].view.keys);
+	}
+
+	// the host keeps serving until the last connection is gone
+	for (int i = 0; i < N; i++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_DISCONNECT;
+		EXPECT_EQ((int)sizeof(pkt), send(mainSocket[i], &pkt, sizeof(pkt), 0));
+		EXPECT_EQ((int)sizeof(pkt), recv(mainSocket[i], &pkt, sizeof(pkt), MSG_WAITALL));
+	}
+	thread.join();
+
+	for (int i = 0; i < N; i++) {
+		close(mainSocket[i]);
+		close(irqSocket[i]);
+		close(mainServer[i]);
+		close(irqServer[i]);
+	}
+}
+
+TEST(Test, HostShouldAnswerReadsFollowedByPostedWrites)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	InstrumentHost host;
+	int mainPort, irqPort;
+	char port1[16], port2[16];
+	int mainServer = listenLocal(&mainPort);
+	int irqServer = listenLocal(&irqPort);
+	struct instrulink_packet pkt[2];
+	struct timeval timeout = { 2, 0 };
+
+	snprintf(port1, sizeof(port1), "%d", mainPort);
+	snprintf(port2, sizeof(port2), "%d", irqPort);
+	char *argv[] = { (char *)"test", port1, port2, (char *)"127.0.0.1" };
+
+	ASSERT_EQ(0, c.init(4, argv));
+	int mainSocket = accept(mainServer, NULL, NULL);
+	int irqSocket = accept(irqServer, NULL, NULL);
+
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+	EXPECT_EQ(0, c.write32(0x1000 + KEYPAD_REG_KEYS, 0x42));
+	EXPECT_EQ(0, host.addContainer(&c));
+	setsockopt(mainSocket, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+
+	std::thread thread([&host] { EXPECT_EQ(0, host.run()); });
+
+	// the read is answered even though the request after it in the segment is not
+	memset(pkt, 0, sizeof(pkt));
+	pkt[0].type = MSG_TYPE_READ32;
+	pkt[0].addr = 0x1000 + KEYPAD_REG_KEYS;
+	pkt[1].type = MSG_TYPE_POSTED_WRITE32;
+	pkt[1].addr = 0x1000 + KEYPAD_REG_KEYS;
+	pkt[1].value = 0x43;
+	EXPECT_EQ((int)sizeof(pkt), send(mainSocket, pkt, sizeof(pkt), 0));
+	EXPECT_EQ((int)sizeof(pkt[0]), recv(mainSocket, &pkt[0], sizeof(pkt[0]), MSG_WAITALL));
+	EXPECT_EQ(MSG_TYPE_OK, pkt[0].type);
+	EXPECT_EQ(0x42u, pkt[0].value);
+
+	memset(pkt, 0, sizeof(pkt));
+	pkt[0].type = MSG_TYPE_DISCONNECT;
+	EXPECT_EQ((int)sizeof(pkt[0]), send(mainSocket, &pkt[0], sizeof(pkt[0]), 0));
+	EXPECT_EQ((int)sizeof(pkt[0]), recv(mainSocket, &pkt[0], sizeof(pkt[0]), MSG_WAITALL));
+	thread.join();
+	a.refresh();
+	EXPECT_EQ(0x43u, a.view.keys);
+
+	close(mainSocket);
+	close(irqSocket);
+	close(mainServer);
+	close(irqServer);
+}
+
+TEST(Test, RealTimeModeShouldReportServiceLatency)
+{
+	TestContainer c;
+	RegisterInstrument a;
+	int mainPort, irqPort;
+	int mainServer = listenLocal(&mainPort);
+	int irqServer = listenLocal(&irqPort);
+	char port1[16], port2[16], cpu[16];
+	struct instrulink_packet pkt;
+	cpu_set_t set;
+
+	// pin to a core we are allowed to run on, priority and memory locking are only recorded
+	ASSERT_EQ(0, sched_getaffinity(0, sizeof(set), &set));
+	int core = 0;
+	while (!CPU_ISSET(core, &set)) {
+		core++;
+	}
+
+	snprintf(port1, sizeof(port1), "%d", mainPort);
+	snprintf(port2, sizeof(port2), "%d", irqPort);
+	snprintf(cpu, sizeof(cpu), "%d", core);
+	char *argv[] = { (char *)"test", (char *)"--rt-cpu", cpu, (char *)"--rt-priority", (char *)"1",
+			 port1, port2, (char *)"127.0.0.1" };
+
+	ASSERT_EQ(0, c.init(8, argv));
+	EXPECT_TRUE(c.isRealTime());
+	int mainSocket = accept(mainServer, NULL, NULL);
+	int irqSocket = accept(irqServer, NULL, NULL);
+	EXPECT_EQ(0, c.addInstrument(&a, 0x1000, sizeof(struct keypad_instrument)));
+
+	std::thread host([&c] { EXPECT_EQ(0, c.run()); });
+
+	for (int i = 0; i < 10; i++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_WRITE32;
+		pkt.addr = 0x1000 + KEYPAD_REG_KEYS;
+		pkt.value = i;
+		EXPECT_EQ((int)sizeof(pkt), send(mainSocket, &pkt, sizeof(pkt), 0));
+		EXPECT_EQ((int)sizeof(pkt), recv(mainSocket, &pkt, sizeof(pkt), MSG_WAITALL));
+		EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+	}
+
+	pkt.type = MSG_TYPE_DISCONNECT;
+	EXPECT_EQ((int)sizeof(pkt), send(mainSocket, &pkt, sizeof(pkt), 0));
+	EXPECT_EQ((int)sizeof(pkt), recv(mainSocket, &pkt, sizeof(pkt), MSG_WAITALL));
+	host.join();
+
+	InstrumentContainer::LatencyStats stats = c.latency();
+
+	// only the serving thread was pinned, the rest was recorded
+	EXPECT_EQ(1, c.fifoPriority);
+	EXPECT_GT(c.lockedHeap, 0u);
+	EXPECT_EQ(11u, stats.requests);
+	EXPECT_GT(stats.worst, 0u);
+	EXPECT_LE(stats.total, stats.worst * stats.requests);
+
+	close(mainSocket);
+	close(irqSocket);
+	close(mainServer);
+	close(irqServer);
+}
+
+TEST(Test, UnknownOptionsShouldBeRejected)
+{
+	TestContainer c;
+	char *argv[] = { (char *)"test", (char *)"--bogus", (char *)"shm", (char *)"x" };
+
+	EXPECT_EQ(-1, c.init(4, argv));
+	EXPECT_FALSE(c.isHeadless());
+}
+
+TEST(Test, InvalidTickThreadCountsShouldBeRejected)
+{
+	const char *counts[] = { "", "two", "2x", "-1", "99999999999999999999", "100000" };
+
+	for (const char *count : counts) {
+		TestContainer c;
+		char *argv[] = { (char *)"test", (char *)"--tick-threads", (char *)count,
+				 (char *)"shm", (char *)"x" };
+
+		EXPECT_EQ(-1, c.init(5, argv)) << count;
+	}
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
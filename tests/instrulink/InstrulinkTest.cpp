@@ -0,0 +1,667 @@
+#include <instruments/protocol/instrulink.h>
+#include <instruments/protocol/shm.h>
+
+#include <gtest/gtest.h>
+#include <thread>
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <sys/syscall.h>
+#include <sys/uio.h>
+#include <sys/un.h>
+#include <sys/wait.h>
+#include <arpa/inet.h>
+#include <netinet/in.h>
+
+/** Socket whose writes are counted (-1 counts none) */
+static int countedFd = -1;
+static int countedWrites = 0;
+
+/** Counts the writes instrulink makes so tests do not depend on how TCP segments them */
+extern "C" ssize_t writev(int fd, const struct iovec *iov, int iovcnt)
+{
+	if (fd == countedFd) {
+		countedWrites++;
+	}
+	return syscall(SYS_writev, fd, iov, iovcnt);
+}
+
+/** Simulator side of a TCP instrulink connection */
+class Simulator {
+    public:
+	Simulator()
+	{
+		mainServer = listenLocal(&mainPort);
+		irqServer = listenLocal(&irqPort);
+	}
+	~Simulator()
+	{
+		close(mainSocket);
+		close(irqSocket);
+		close(mainServer);
+		close(irqServer);
+	}
+	void accept()
+	{
+		mainSocket = ::accept(mainServer, NULL, NULL);
+		irqSocket = ::accept(irqServer, NULL, NULL);
+	}
+	int send(const void *data, size_t len)
+	{
+		return ::send(mainSocket, data, len, 0);
+	}
+	int recv(void *data, size_t len)
+	{
+		return ::recv(mainSocket, data, len, MSG_WAITALL);
+	}
+
+	int mainPort = 0;
+	int irqPort = 0;
+	int mainSocket = -1;
+	int irqSocket = -1;
+
+    private:
+	static int listenLocal(int *port)
+	{
+		int fd = socket(AF_INET, SOCK_STREAM, 0);
+		struct sockaddr_in addr;
+		socklen_t len = sizeof(addr);
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sin_family = AF_INET;
+		addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+		bind(fd, (struct sockaddr *)&addr, sizeof(addr));
+		listen(fd, 1);
+		getsockname(fd, (struct sockaddr *)&addr, &len);
+		*port = ntohs(addr.sin_port);
+		return fd;
+	}
+	int mainServer;
+	int irqServer;
+};
+
+static struct instrulink *connectTCP(Simulator *sim)
+{
+	struct instrulink *link = instrulink_new();
+
+	EXPECT_EQ(0, instrulink_connect(link, sim->mainPort, sim->irqPort, "127.0.0.1"));
+	sim->accept();
+	return link;
+}
+
+TEST(Test, BatchShouldBeReceivedAndAnsweredInOneFrame)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_packet req[4];
+
+	memset(req, 0, sizeof(req));
+	req[0].type = MSG_TYPE_BATCH;
+	req[0].value = 3;
+	for (int c = 1; c < 4; c++) {
+		req[c].type = MSG_TYPE_READ32;
+		req[c].addr = c * 4;
+	}
+	EXPECT_EQ((int)sizeof(req), sim.send(req, sizeof(req)));
+
+	struct instrulink_packet hdr;
+	struct instrulink_packet ops[INSTRULINK_BATCH_MAX];
+
+	EXPECT_EQ(0, instrulink_wait_request(link, &hdr));
+	EXPECT_EQ(MSG_TYPE_BATCH, hdr.type);
+	EXPECT_EQ(3, hdr.value);
+	EXPECT_EQ(0, instrulink_wait_batch(link, ops, hdr.value));
+	for (int c = 0; c < 3; c++) {
+		EXPECT_EQ(MSG_TYPE_READ32, ops[c].type);
+		EXPECT_EQ((uint64_t)(c + 1) * 4, ops[c].addr);
+		ops[c].type = MSG_TYPE_OK;
+		ops[c].value = c;
+	}
+	EXPECT_EQ(0, instrulink_send_batch_response(link, ops, 3));
+
+	struct instrulink_packet res[4];
+
+	EXPECT_EQ((int)sizeof(res), sim.recv(res, sizeof(res)));
+	EXPECT_EQ(MSG_TYPE_BATCH, res[0].type);
+	EXPECT_EQ(3, res[0].value);
+	for (int c = 1; c < 4; c++) {
+		EXPECT_EQ(MSG_TYPE_OK, res[c].type);
+		EXPECT_EQ((uint64_t)c - 1, res[c].value);
+	}
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, BlockPayloadShouldFollowHeader)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_packet req;
+	struct instrulink_packet pkt;
+	uint8_t out[INSTRULINK_BLOCK_MAX];
+	uint8_t in[INSTRULINK_BLOCK_MAX];
+
+	for (size_t c = 0; c < sizeof(out); c++) {
+		out[c] = c * 7;
+	}
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_WRITE_BLOCK;
+	req.value = sizeof(out);
+
+	std::thread simulator([&sim, &req, &out]() {
+		sim.send(&req, sizeof(req));
+		sim.send(out, sizeof(out));
+	});
+
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	EXPECT_EQ(MSG_TYPE_WRITE_BLOCK, pkt.type);
+	EXPECT_EQ(0, instrulink_wait_block(link, in, pkt.value));
+	EXPECT_EQ(0, memcmp(in, out, sizeof(in)));
+	simulator.join();
+
+	pkt.type = MSG_TYPE_OK;
+	EXPECT_EQ(0, instrulink_send_block_response(link, &pkt, out, sizeof(out)));
+	EXPECT_EQ((int)sizeof(pkt), sim.recv(&pkt, sizeof(pkt)));
+	EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+	EXPECT_EQ((int)sizeof(in), sim.recv(in, sizeof(in)));
+	EXPECT_EQ(0, memcmp(in, out, sizeof(in)));
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, SplitPacketsShouldBeReassembled)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_packet req;
+	struct instrulink_packet pkt;
+
+	memset(&req, 0, sizeof(req));
+	req.type = MSG_TYPE_WRITE32;
+	req.addr = 0x1234;
+	req.value = 0x5678;
+
+	std::thread simulator([&sim, &req]() {
+		const uint8_t *data = (const uint8_t *)&req;
+
+		// deliver one byte at a time
+		for (size_t c = 0; c < sizeof(req); c++) {
+			sim.send(&data[c], 1);
+			usleep(100);
+		}
+	});
+
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	EXPECT_EQ(0, memcmp(&req, &pkt, sizeof(req)));
+
+	simulator.join();
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+/** Take in data until a complete request is buffered (false after a deadline) */
+static bool receiveRequest(struct instrulink *link)
+{
+	struct pollfd pfd = { .fd = instrulink_fd(link), .events = POLLIN, .revents = 0 };
+
+	for (int c = 0; c < 50; c++) {
+		EXPECT_EQ(0, instrulink_receive(link));
+		if (instrulink_pending(link)) {
+			return true;
+		}
+		poll(&pfd, 1, 100);
+	}
+	return false;
+}
+
+TEST(Test, PartialRequestsShouldStayBufferedWhenPolled)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_packet req[3];
+	struct instrulink_packet ops[2];
+	struct instrulink_packet hdr;
+	uint8_t data[8];
+
+	ASSERT_EQ(0, instrulink_set_nonblocking(link));
+	EXPECT_EQ(0, instrulink_receive(link));
+	EXPECT_FALSE(instrulink_pending(link));
+
+	// a batch is only complete once all of its operations are here
+	memset(req, 0, sizeof(req));
+	req[0].type = MSG_TYPE_BATCH;
+	req[0].value = 2;
+	req[1].type = MSG_TYPE_READ32;
+	req[1].addr = 4;
+	req[2].type = MSG_TYPE_READ32;
+	req[2].addr = 8;
+	EXPECT_EQ((int)sizeof(req) - 7, sim.send(req, sizeof(req) - 7));
+	usleep(10000);
+	EXPECT_EQ(0, instrulink_receive(link));
+	EXPECT_FALSE(instrulink_pending(link));
+	EXPECT_EQ(7, sim.send((uint8_t *)req + sizeof(req) - 7, 7));
+	ASSERT_TRUE(receiveRequest(link));
+	EXPECT_EQ(0, instrulink_wait_request(link, &hdr));
+	EXPECT_EQ(MSG_TYPE_BATCH, hdr.type);
+	EXPECT_EQ(0, instrulink_wait_batch(link, ops, 2));
+	EXPECT_EQ(8, ops[1].addr);
+	EXPECT_FALSE(instrulink_pending(link));
+
+	// and a block write once all of its payload is
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = MSG_TYPE_WRITE_BLOCK;
+	hdr.value = sizeof(data);
+	memset(data, 0xa5, sizeof(data));
+	EXPECT_EQ((int)sizeof(hdr), sim.send(&hdr, sizeof(hdr)));
+	EXPECT_EQ(4, sim.send(data, 4));
+	usleep(10000);
+	EXPECT_EQ(0, instrulink_receive(link));
+	EXPECT_FALSE(instrulink_pending(link));
+	EXPECT_EQ(4, sim.send(data + 4, 4));
+	ASSERT_TRUE(receiveRequest(link));
+	EXPECT_EQ(0, instrulink_wait_request(link, &hdr));
+	memset(data, 0, sizeof(data));
+	EXPECT_EQ(0, instrulink_wait_block(link, data, sizeof(data)));
+	EXPECT_EQ(0xa5, data[7]);
+
+	// a hangup is reported once everything buffered has been handed out
+	close(sim.mainSocket);
+	sim.mainSocket = -1;
+	struct pollfd pfd = { .fd = instrulink_fd(link), .events = POLLIN, .revents = 0 };
+	poll(&pfd, 1, 5000);
+	EXPECT_EQ(-EIO, instrulink_receive(link));
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, BusyPollShouldPickUpRequestsWithoutBlocking)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_wait_stats stats;
+	struct instrulink_packet pkt;
+
+	memset(&pkt, 0, sizeof(pkt));
+	pkt.type = MSG_TYPE_READ32;
+
+	// without busy polling every wait blocks
+	EXPECT_EQ((int)sizeof(pkt), sim.send(&pkt, sizeof(pkt)));
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	instrulink_get_wait_stats(link, &stats);
+	EXPECT_EQ(0u, stats.polled);
+	EXPECT_EQ(1u, stats.blocked);
+
+	// a request arriving within the spin time is picked up while polling
+	instrulink_set_busy_poll(link, 2000000);
+	std::thread sender([&sim, &pkt] {
+		usleep(1000);
+		EXPECT_EQ((int)sizeof(pkt), sim.send(&pkt, sizeof(pkt)));
+	});
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	sender.join();
+	instrulink_get_wait_stats(link, &stats);
+	EXPECT_EQ(1u, stats.polled);
+	EXPECT_EQ(1u, stats.blocked);
+
+	// and falls back to blocking once the spin time has passed
+	instrulink_set_busy_poll(link, 100);
+	sender = std::thread([&sim, &pkt] {
+		usleep(20000);
+		EXPECT_EQ((int)sizeof(pkt), sim.send(&pkt, sizeof(pkt)));
+	});
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	sender.join();
+	instrulink_get_wait_stats(link, &stats);
+	EXPECT_EQ(1u, stats.polled);
+	EXPECT_EQ(2u, stats.blocked);
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, ResponsesShouldBeFlushedTogetherWhenQueueDrains)
+{
+	Simulator sim;
+	struct instrulink *link = connectTCP(&sim);
+	struct instrulink_packet req[8];
+	struct instrulink_packet pkt;
+
+	memset(req, 0, sizeof(req));
+	for (int c = 0; c < 8; c++) {
+		req[c].type = MSG_TYPE_READ32;
+		req[c].addr = c;
+	}
+	EXPECT_EQ((int)sizeof(req), sim.send(req, sizeof(req)));
+
+	countedFd = instrulink_fd(link);
+	countedWrites = 0;
+	for (int c = 0; c < 8; c++) {
+		EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+		EXPECT_EQ((uint64_t)c, pkt.addr);
+		pkt.type = MSG_TYPE_OK;
+		EXPECT_EQ(0, instrulink_send_response(link, &pkt));
+		if (c < 7) {
+			// nothing is sent while requests are still queued
+			EXPECT_EQ(-1, recv(sim.mainSocket, &pkt, sizeof(pkt), MSG_DONTWAIT));
+		}
+	}
+	countedFd = -1;
+	// all responses went out in a single write
+	EXPECT_EQ(1, countedWrites);
+
+	EXPECT_EQ((int)sizeof(req), sim.recv(req, sizeof(req)));
+	for (int c = 0; c < 8; c++) {
+		EXPECT_EQ(MSG_TYPE_OK, req[c].type);
+		EXPECT_EQ((uint64_t)c, req[c].addr);
+	}
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+/** Simulator side of a unix domain socket instrulink connection */
+class UnixSimulator {
+    public:
+	UnixSimulator()
+	{
+		snprintf(mainPath, sizeof(mainPath), "@instrulink-test-%d-main", getpid());
+		snprintf(irqPath, sizeof(irqPath), "@instrulink-test-%d-irq", getpid());
+		mainServer = listenUnix(mainPath);
+		irqServer = listenUnix(irqPath);
+	}
+	~UnixSimulator()
+	{
+		close(mainSocket);
+		close(irqSocket);
+		close(mainServer);
+		close(irqServer);
+	}
+	void accept()
+	{
+		mainSocket = ::accept(mainServer, NULL, NULL);
+		irqSocket = ::accept(irqServer, NULL, NULL);
+	}
+
+	char mainPath[64];
+	char irqPath[64];
+	int mainSocket = -1;
+	int irqSocket = -1;
+
+    private:
+	static int listenUnix(const char *path)
+	{
+		int fd = socket(AF_UNIX, SOCK_SEQPACKET, 0);
+		struct sockaddr_un addr;
+
+		memset(&addr, 0, sizeof(addr));
+		addr.sun_family = AF_UNIX;
+		strcpy(addr.sun_path, path);
+		addr.sun_path[0] = 0;
+		bind(fd, (struct sockaddr *)&addr, offsetof(struct sockaddr_un, sun_path) + strlen(path));
+		listen(fd, 1);
+		return fd;
+	}
+	int mainServer;
+	int irqServer;
+};
+
+TEST(Test, SeqpacketShouldPreserveFrameBoundaries)
+{
+	UnixSimulator sim;
+	struct instrulink *link = instrulink_new();
+	struct instrulink_packet req[3];
+	struct instrulink_packet ops[INSTRULINK_BATCH_MAX];
+	struct instrulink_packet pkt;
+
+	EXPECT_EQ(0, instrulink_connect_unix(link, sim.mainPath, sim.irqPath));
+	sim.accept();
+
+	// a batch frame followed by a single request, each one message
+	memset(req, 0, sizeof(req));
+	req[0].type = MSG_TYPE_BATCH;
+	req[0].value = 2;
+	req[1].type = MSG_TYPE_WRITE32;
+	req[2].type = MSG_TYPE_READ32;
+	EXPECT_EQ((int)sizeof(req), send(sim.mainSocket, req, sizeof(req), 0));
+	req[0].type = MSG_TYPE_READ8;
+	EXPECT_EQ((int)sizeof(req[0]), send(sim.mainSocket, req, sizeof(req[0]), 0));
+
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	EXPECT_EQ(MSG_TYPE_BATCH, pkt.type);
+	EXPECT_EQ(0, instrulink_wait_batch(link, ops, pkt.value));
+	EXPECT_EQ(MSG_TYPE_WRITE32, ops[0].type);
+	EXPECT_EQ(MSG_TYPE_READ32, ops[1].type);
+	EXPECT_EQ(0, instrulink_send_batch_response(link, ops, 2));
+	EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+	EXPECT_EQ(MSG_TYPE_READ8, pkt.type);
+	EXPECT_EQ(0, instrulink_send_response(link, &pkt));
+
+	// batch response arrives as one message
+	EXPECT_EQ((int)sizeof(req), recv(sim.mainSocket, req, sizeof(req) * 2, 0));
+	EXPECT_EQ(MSG_TYPE_BATCH, req[0].type);
+	EXPECT_EQ((int)sizeof(req[0]), recv(sim.mainSocket, req, sizeof(req), 0));
+	EXPECT_EQ(MSG_TYPE_READ8, req[0].type);
+
+	EXPECT_EQ(0, instrulink_irq_notify(link, 0x5));
+	EXPECT_EQ((int)sizeof(pkt), recv(sim.irqSocket, &pkt, sizeof(pkt), 0));
+	EXPECT_EQ(MSG_TYPE_IRQ, pkt.type);
+	EXPECT_EQ(0x5, pkt.value);
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+/** Simulator side of a shared memory instrulink connection */
+class SharedMemorySimulator {
+    public:
+	SharedMemorySimulator()
+	{
+		fd = memfd_create("instrulink", 0);
+		EXPECT_EQ(0, ftruncate(fd, sizeof(struct instrulink_shm)));
+		shm = (struct instrulink_shm *)mmap(NULL, sizeof(*shm), PROT_READ | PROT_WRITE,
+						    MAP_SHARED, fd, 0);
+		instrulink_shm_init(shm);
+		snprintf(name, sizeof(name), "fd:%d", fd);
+	}
+	~SharedMemorySimulator()
+	{
+		munmap(shm, sizeof(*shm));
+		close(fd);
+	}
+
+	struct instrulink_shm *shm;
+	char name[32];
+
+    private:
+	int fd;
+};
+
+TEST(Test, SharedMemoryShouldCarryRequestsResponsesAndIRQs)
+{
+	SharedMemorySimulator sim;
+	struct instrulink *link = instrulink_new();
+	struct instrulink_packet pkt;
+
+	EXPECT_EQ(0, instrulink_connect_shm(link, sim.name));
+
+	for (int c = 0; c < 1000; c++) {
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_READ32;
+		pkt.addr = c;
+		instrulink_shm_ring_write(sim.shm, &sim.shm->req, &pkt, sizeof(pkt));
+
+		EXPECT_EQ(0, instrulink_wait_request(link, &pkt));
+		EXPECT_EQ(MSG_TYPE_READ32, pkt.type);
+		EXPECT_EQ((uint64_t)c, pkt.addr);
+		pkt.type = MSG_TYPE_OK;
+		pkt.value = c * 2;
+		EXPECT_EQ(0, instrulink_send_response(link, &pkt));
+
+		instrulink_shm_ring_read(sim.shm, &sim.shm->res, &pkt, sizeof(pkt));
+		EXPECT_EQ(MSG_TYPE_OK, pkt.type);
+		EXPECT_EQ((uint64_t)c * 2, pkt.value);
+	}
+
+	EXPECT_EQ(0, instrulink_irq_notify(link, 1 << 3));
+	EXPECT_EQ(sizeof(pkt), instrulink_shm_ring_used(&sim.shm->irq));
+	instrulink_shm_ring_read(sim.shm, &sim.shm->irq, &pkt, sizeof(pkt));
+	EXPECT_EQ(MSG_TYPE_IRQ, pkt.type);
+	EXPECT_EQ(1 << 3, pkt.value);
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, SharedMemoryShouldOnlyReportCompleteRequests)
+{
+	SharedMemorySimulator sim;
+	struct instrulink *link = instrulink_new();
+	struct instrulink_packet req[3];
+	struct instrulink_packet ops[2];
+	struct instrulink_packet hdr;
+	static uint8_t data[INSTRULINK_BLOCK_MAX];
+	static uint8_t block[INSTRULINK_BLOCK_MAX];
+
+	EXPECT_EQ(0, instrulink_connect_shm(link, sim.name));
+	EXPECT_FALSE(instrulink_pending(link));
+
+	// a batch is only complete once all of its operations are in the ring
+	memset(req, 0, sizeof(req));
+	req[0].type = MSG_TYPE_BATCH;
+	req[0].value = 2;
+	req[1].type = MSG_TYPE_READ32;
+	req[1].addr = 4;
+	req[2].type = MSG_TYPE_READ32;
+	req[2].addr = 8;
+	instrulink_shm_ring_write(sim.shm, &sim.shm->req, req, sizeof(req) - 7);
+	EXPECT_FALSE(instrulink_pending(link));
+	instrulink_shm_ring_write(sim.shm, &sim.shm->req, (uint8_t *)req + sizeof(req) - 7, 7);
+	EXPECT_TRUE(instrulink_pending(link));
+	EXPECT_EQ(0, instrulink_wait_request(link, &hdr));
+	EXPECT_EQ(0, instrulink_wait_batch(link, ops, 2));
+	EXPECT_EQ(8, ops[1].addr);
+	EXPECT_FALSE(instrulink_pending(link));
+
+	// a block larger than the ring is reported once the ring is full
+	memset(&hdr, 0, sizeof(hdr));
+	hdr.type = MSG_TYPE_WRITE_BLOCK;
+	hdr.value = sizeof(data);
+	memset(data, 0xa5, sizeof(data));
+	instrulink_shm_ring_write(sim.shm, &sim.shm->req, &hdr, sizeof(hdr));
+	instrulink_shm_ring_write(sim.shm, &sim.shm->req, data, 16);
+	EXPECT_FALSE(instrulink_pending(link));
+	instrulink_shm_ring_write(sim.shm, &sim.shm->req, data + 16,
+				  INSTRULINK_SHM_RING_SIZE - sizeof(hdr) - 16);
+	EXPECT_TRUE(instrulink_pending(link));
+
+	std::thread simulator([&sim]() {
+		instrulink_shm_ring_write(sim.shm, &sim.shm->req,
+					  data + INSTRULINK_SHM_RING_SIZE - sizeof(hdr),
+					  sizeof(data) - (INSTRULINK_SHM_RING_SIZE - sizeof(hdr)));
+	});
+
+	EXPECT_EQ(0, instrulink_wait_request(link, &hdr));
+	EXPECT_EQ(0, instrulink_wait_block(link, block, sizeof(block)));
+	simulator.join();
+	EXPECT_EQ(0, memcmp(data, block, sizeof(block)));
+	EXPECT_FALSE(instrulink_pending(link));
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, SharedMemoryShouldWakeUpBlockedPeer)
+{
+	SharedMemorySimulator sim;
+	struct instrulink *link = instrulink_new();
+	const int count = 10000;
+
+	EXPECT_EQ(0, instrulink_connect_shm(link, sim.name));
+
+	std::thread instrument([link]() {
+		struct instrulink_packet pkt;
+
+		for (int c = 0; c < count; c++) {
+			instrulink_wait_request(link, &pkt);
+			pkt.value = pkt.addr + 1;
+			instrulink_send_response(link, &pkt);
+		}
+	});
+
+	for (int c = 0; c < count; c++) {
+		struct instrulink_packet pkt;
+
+		memset(&pkt, 0, sizeof(pkt));
+		pkt.type = MSG_TYPE_READ32;
+		pkt.addr = c;
+		instrulink_shm_ring_write(sim.shm, &sim.shm->req, &pkt, sizeof(pkt));
+		instrulink_shm_ring_read(sim.shm, &sim.shm->res, &pkt, sizeof(pkt));
+		EXPECT_EQ((uint64_t)c + 1, pkt.value);
+	}
+
+	instrument.join();
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, SharedMemoryShouldFailWhenSimulatorIsGone)
+{
+	SharedMemorySimulator sim;
+	struct instrulink *link = instrulink_new();
+	struct instrulink_packet pkt;
+
+	EXPECT_EQ(0, instrulink_connect_shm(link, sim.name));
+	EXPECT_EQ(getpid(), sim.shm->instrument_pid);
+
+	// a simulator that died without closing the segment is noticed by its pid
+	pid_t child = fork();
+
+	if (child == 0) {
+		_exit(0);
+	}
+	EXPECT_EQ(child, waitpid(child, NULL, 0));
+	sim.shm->simulator_pid = child;
+	EXPECT_EQ(-EIO, instrulink_wait_request(link, &pkt));
+
+	// a simulator that disconnects wakes up the blocked instrument
+	sim.shm->simulator_pid = getpid();
+
+	std::thread instrument([link]() {
+		struct instrulink_packet pkt;
+
+		EXPECT_EQ(-EIO, instrulink_wait_request(link, &pkt));
+	});
+
+	usleep(10000);
+	instrulink_shm_close(sim.shm);
+	instrument.join();
+
+	instrulink_disconnect(link);
+	instrulink_free(&link);
+}
+
+TEST(Test, SharedMemoryShouldRejectUninitializedSegment)
+{
+	SharedMemorySimulator sim;
+	struct instrulink *link = instrulink_new();
+
+	sim.shm->magic = 0;
+	EXPECT_EQ(-EINVAL, instrulink_connect_shm(link, sim.name));
+	EXPECT_EQ(-ECONNREFUSED, instrulink_connect_shm(link, "/instrulink-does-not-exist"));
+	instrulink_free(&link);
+}
+
+int main(int argc, char **argv)
+{
+	testing::InitGoogleTest(&argc, argv);
+	return RUN_ALL_TESTS();
+}
@@ -53,6 +53,25 @@ TEST(Test, RegistersShouldReflectKeyPress)
 	}
 }
 
+TEST(Test, BlockAccessesShouldBehaveLikeWordAccesses)
+{
+	KeypadInstrument ins;
+	uint32_t out[2] = { 0xffff, 0 };
+	uint32_t in[2] = { 0 };
+
+	ins.setKeyState(3, true);
+	// the keys can not be written and reading the changed keys resets them
+	EXPECT_EQ(0, ins.writeBlock(KEYPAD_REG_KEYS, (uint8_t *)out, sizeof(out)));
+	EXPECT_EQ(0, ins.readBlock(KEYPAD_REG_KEYS, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(1u << 3, in[0]);
+	EXPECT_EQ(0u, in[1]);
+	ins.setKeyState(3, false);
+	EXPECT_EQ(0, ins.readBlock(KEYPAD_REG_KEYS, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(1u << 3, in[1]);
+	EXPECT_EQ(0, ins.readBlock(KEYPAD_REG_KEYS, (uint8_t *)in, sizeof(in)));
+	EXPECT_EQ(0u, in[1]);
+}
+
 int main(int argc, char **argv)
 {
 	testing::InitGoogleTest(&argc, argv);
@@ -63,14 +63,172 @@ TEST(Test, UartShouldTransmitFFData)
 	test_tx_data(0xff);
 }
 
-TEST(Test, UnsupportedReadsShouldReturnENOTSUP)
+TEST(Test, FastForwardShouldMatchCycleByCycleSimulation)
+{
+	std::unique_ptr<LiteUART> fast(new LiteUART());
+	std::unique_ptr<LiteUART> slow(new LiteUART());
+
+	slow->setFastForward(false);
+	fast->tick(TICKS_PER_BIT);
+	slow->tick(TICKS_PER_BIT);
+	fast->tx(0x5a);
+	slow->tx(0x5a);
+
+	// sample the line often enough to see every bit edge of the frame and the idle time after it
+	for (int c = 0; c < 12 * TICKS_PER_BIT / 7; c++) {
+		fast->tick(7);
+		slow->tick(7);
+		ASSERT_EQ(slow->txo(), fast->txo()) << "cycle " << c * 7;
+	}
+
+	uint64_t cycles = fast->clock().evaluated + fast->clock().skipped;
+
+	EXPECT_EQ(slow->clock().evaluated, cycles);
+	// only a few cycles per bit are evaluated
+	EXPECT_LT(fast->clock().evaluated, cycles / 100);
+}
+
+TEST(Test, LazyClockShouldCatchUpWhenObserved)
+{
+	std::unique_ptr<LiteUART> lazy(new LiteUART());
+	std::unique_ptr<LiteUART> eager(new LiteUART());
+	// one bit time at 100 MHz in ns
+	const uint64_t bit_ns = TICKS_PER_BIT * 10ULL;
+
+	eager->setLazyClock(false);
+	lazy->advance(bit_ns);
+	eager->advance(bit_ns);
+	EXPECT_EQ(0, lazy->clock().evaluated + lazy->clock().skipped);
+	EXPECT_EQ(TICKS_PER_BIT, lazy->lag());
+
+	// the write catches the model up before the bus cycle
+	lazy->tx(0xa5);
+	eager->tx(0xa5);
+	EXPECT_EQ(0, lazy->lag());
+
+	for (int c = 0; c < 24; c++) {
+		lazy->advance(bit_ns / 2);
+		eager->advance(bit_ns / 2);
+		ASSERT_EQ(eager->txo(), lazy->txo()) << "half bit " << c;
+	}
+	EXPECT_EQ(eager->clock().evaluated + eager->clock().skipped,
+		  lazy->clock().evaluated + lazy->clock().skipped);
+
+	// nothing is run while nobody looks
+	uint64_t evaluated = lazy->clock().evaluated;
+
+	lazy->advance(1000000);
+	EXPECT_EQ(evaluated, lazy->clock().evaluated);
+	EXPECT_FALSE(lazy->pollIRQ());
+	EXPECT_EQ(0, lazy->lag());
+}
+
+TEST(Test, EndOfQuantumShouldBringModelUpToDate)
+{
+	std::unique_ptr<LiteUART> liteuart(new LiteUART());
+	LiteUART *uart = liteuart.get();
+	UARTInstrument ins(std::move(liteuart));
+
+	ins.advance(TICKS_PER_BIT * 10ULL);
+	EXPECT_EQ(TICKS_PER_BIT, uart->lag());
+
+	// the interrupt output is polled with the model at the end of the quantum
+	ins.endQuantum();
+	EXPECT_EQ(0, uart->lag());
+}
+
+TEST(Test, LongIdlePeriodsShouldNotBeTruncated)
+{
+	std::unique_ptr<LiteUART> uart(new LiteUART());
+	// more cycles than fit into 32 bits
+	const uint64_t steps = (1ULL << 32) + 5;
+
+	uart->tick(TICKS_PER_BIT);
+
+	uint64_t start = uart->clock().evaluated + uart->clock().skipped;
+
+	uart->tick(steps);
+	EXPECT_EQ(start + steps, uart->clock().evaluated + uart->clock().skipped);
+
+	// 50 s at 100 MHz granted in one quantum
+	uart->setClockFrequency(UART_FREQ);
+	uart->advance(50000000000ULL);
+	EXPECT_EQ(5000000000ULL, uart->lag());
+	uart->catchUp();
+	EXPECT_EQ(start + steps + 5000000000ULL,
+		  uart->clock().evaluated + uart->clock().skipped);
+
+	// and the model still works afterwards
+	uart->tx(0x00);
+	uart->tick(TICKS_PER_BIT / 2);
+	EXPECT_EQ(0, uart->txo());
+}
+
+TEST(Test, BlockAccessesShouldWorkInEveryBusMode)
+{
+	const WishboneMode modes[] = { WISHBONE_CLASSIC, WISHBONE_PIPELINED, WISHBONE_BURST };
+	uint32_t expected[8];
+	uint64_t classic_cycles = 0;
+
+	for (auto mode : modes) {
+		std::unique_ptr<LiteUART> uart(new LiteUART());
+		uint32_t regs[8];
+		uint32_t out[1] = { 0xc3 };
+
+		uart->setFastForward(false);
+		uart->setBusMode(mode);
+		uart->tick();
+
+		uint64_t start = uart->clock().evaluated;
+
+		EXPECT_EQ(0, uart->readBlock(LITEUART_REG_RXTX, (uint8_t *)regs, sizeof(regs)));
+
+		uint64_t cycles = uart->clock().evaluated - start;
+
+		if (mode == WISHBONE_CLASSIC) {
+			memcpy(expected, regs, sizeof(regs));
+			classic_cycles = cycles;
+		} else {
+			EXPECT_EQ(0, memcmp(expected, regs, sizeof(regs)));
+			EXPECT_LT(cycles, classic_cycles);
+		}
+		// rx fifo is empty
+		EXPECT_EQ(1, regs[2]);
+
+		// a block written into the tx register goes out on the line
+		EXPECT_EQ(0, uart->writeBlock(LITEUART_REG_RXTX, (uint8_t *)out, sizeof(out)));
+		uart->tick(TICKS_PER_BIT / 2);
+		EXPECT_EQ(0, uart->txo());
+		for (int i = 0; i < 8; i++) {
+			uart->tick(TICKS_PER_BIT);
+			EXPECT_EQ((out[0] >> i) & 1, uart->txo());
+		}
+	}
+}
+
+TEST(Test, NarrowAccessesShouldUseByteLanes)
 {
 	uint64_t value = 0;
 	std::unique_ptr<LiteUART> liteuart(new LiteUART());
+	LiteUART *uart = liteuart.get();
 	UARTInstrument ins(std::move(liteuart));
 
-	EXPECT_EQ(-ENOTSUP, ins.read8(0, &value));
-	EXPECT_EQ(-ENOTSUP, ins.read16(0, &value));
+	uart->tick();
+	EXPECT_EQ(0, ins.read8(LITEUART_REG_RXEMPTY, &value));
+	EXPECT_EQ(1, value);
+	EXPECT_EQ(0, ins.read8(LITEUART_REG_RXEMPTY + 1, &value));
+	EXPECT_EQ(0, value);
+	EXPECT_EQ(0, ins.read16(LITEUART_REG_RXEMPTY, &value));
+	EXPECT_EQ(1, value);
+	EXPECT_EQ(-EINVAL, ins.read16(LITEUART_REG_RXEMPTY + 1, &value));
+	EXPECT_EQ(-EINVAL, ins.write16(LITEUART_REG_RXTX + 3, 0x55));
+
+	// a byte store to the data register starts a frame
+	EXPECT_EQ(0, ins.write8(LITEUART_REG_RXTX, 0x55));
+	uart->tick(TICKS_PER_BIT / 2);
+	EXPECT_EQ(0, uart->txo());
+	uart->tick(TICKS_PER_BIT);
+	EXPECT_EQ(1, uart->txo());
 }
 
 int main(int argc, char **argv)